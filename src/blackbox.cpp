@@ -0,0 +1,150 @@
+#include "blackbox.h"
+#include <inttypes.h>
+#include <esp_attr.h>
+#include <esp_task_wdt.h>
+
+const uint32_t BLACKBOX_MAGIC = 0x424C4258; //"BLBX"
+
+struct BlackboxStore {
+  uint32_t magic; //Marks the store as initialized
+  uint32_t count; //Number of records ever written, the ring keeps the last BLACKBOX_RECORDS
+  uint16_t stage; //Stage in progress (BB_IDLE between stages)
+  uint16_t stage_arg;
+  BlackboxRecord records[BLACKBOX_RECORDS];
+};
+
+static_assert((BLACKBOX_RECORDS & (BLACKBOX_RECORDS - 1)) == 0, "BLACKBOX_RECORDS must be a power of two");
+static_assert(sizeof(BlackboxStore) <= BLACKBOX_BYTE_BUDGET, "Blackbox trace exceeds its RTC memory budget");
+
+//Kept out of .bss so it is not cleared on reset
+RTC_NOINIT_ATTR BlackboxStore blackbox_store;
+
+//Copy of the crashed boot's last events, taken before the new boot overwrites them
+CrashReport crash_report;
+bool crash_report_pending = false;
+
+const char* const BLACKBOX_EVENT_NAMES[BB_EVENT_COUNT] = {
+  "idle", "boot", "wifi", "setup done", "telemetry send", "dht request", "dht read", "draw", "button",
+  "command", "lan stream", "watchdog stall"
+};
+
+const char* blackboxEventName(uint16_t event) {
+  event &= ~BLACKBOX_END;
+  return event < BB_EVENT_COUNT ? BLACKBOX_EVENT_NAMES[event] : "?";
+}
+
+const char* resetReasonName(esp_reset_reason_t reason) {
+  switch(reason) {
+    case ESP_RST_POWERON: return "power on";
+    case ESP_RST_EXT: return "external reset";
+    case ESP_RST_SW: return "software reset";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "interrupt watchdog";
+    case ESP_RST_TASK_WDT: return "task watchdog";
+    case ESP_RST_WDT: return "watchdog";
+    case ESP_RST_DEEPSLEEP: return "deep sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default: return "unknown";
+  }
+}
+
+//Resets that mean the previous boot did not end on purpose
+bool isCrash(esp_reset_reason_t reason) {
+  return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+    reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT;
+}
+
+//A couple of stores and an increment; in IRAM so the watchdog interrupt can call it too
+void IRAM_ATTR blackboxRecord(uint16_t event, uint16_t arg) {
+  BlackboxRecord& record = blackbox_store.records[blackbox_store.count & (BLACKBOX_RECORDS - 1)];
+  record.time_us = micros();
+  record.event = event;
+  record.arg = arg;
+  ++blackbox_store.count;
+}
+
+void blackboxBegin(BlackboxEvent stage, uint16_t arg) {
+  blackbox_store.stage = stage;
+  blackbox_store.stage_arg = arg;
+  blackboxRecord(stage, arg);
+}
+
+void blackboxEnd(BlackboxEvent stage) {
+  blackbox_store.stage = BB_IDLE;
+  blackboxRecord(stage | BLACKBOX_END, 0);
+}
+
+//Print the previous boot's records, oldest first, with times relative to the last one
+void dumpBlackbox(esp_reset_reason_t reason) {
+  uint32_t count = min<uint32_t>(blackbox_store.count, BLACKBOX_RECORDS);
+  uint32_t first = blackbox_store.count - count;
+  const BlackboxRecord& last = blackbox_store.records[(blackbox_store.count - 1) & (BLACKBOX_RECORDS - 1)];
+
+  Serial.printf("[blackbox] previous boot ended by %s during %s, last %" PRIu32 " events:\n",
+    resetReasonName(reason), blackboxEventName(blackbox_store.stage), count);
+  for(uint32_t i = first; i < blackbox_store.count; ++i) {
+    const BlackboxRecord& record = blackbox_store.records[i & (BLACKBOX_RECORDS - 1)];
+    Serial.printf("[blackbox] %9.3f ms %s%s %u\n", -(int32_t) (last.time_us - record.time_us) / 1000.0,
+      blackboxEventName(record.event), record.event & BLACKBOX_END ? " end" : "", record.arg);
+  }
+
+  if(CRASH_REPORT_EVENTS > 0 && isCrash(reason)) {
+    crash_report.reason = reason;
+    crash_report.stage = blackbox_store.stage;
+    crash_report.stage_arg = blackbox_store.stage_arg;
+    crash_report.count = min<uint32_t>(count, CRASH_REPORT_EVENTS);
+    for(int i = 0; i < crash_report.count; ++i) {
+      BlackboxRecord record = blackbox_store.records[(blackbox_store.count - crash_report.count + i) & (BLACKBOX_RECORDS - 1)];
+      record.time_us = last.time_us - record.time_us;
+      crash_report.events[i] = record;
+    }
+    crash_report_pending = true;
+  }
+}
+
+//Keep the trace from before a reset long enough to dump it, unless the device lost power
+void blackboxStart() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  if(reason != ESP_RST_POWERON && blackbox_store.magic == BLACKBOX_MAGIC && blackbox_store.count > 0) {
+    dumpBlackbox(reason);
+  }
+  memset(&blackbox_store, 0, sizeof(blackbox_store));
+  blackbox_store.magic = BLACKBOX_MAGIC;
+  blackboxRecord(BB_BOOT, reason);
+}
+
+//Called by ESP-IDF from the task watchdog interrupt, before it panics and resets the chip
+extern "C" void IRAM_ATTR esp_task_wdt_isr_user_handler(void) {
+  blackboxRecord(BB_STALL, blackbox_store.stage);
+}
+
+void startWatchdog() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  //Idle tasks stay watched as the core configured them
+  esp_task_wdt_config_t config = {};
+  config.timeout_ms = WATCHDOG_TIMEOUT_S * 1000;
+  config.trigger_panic = true;
+#ifdef CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU0
+  config.idle_core_mask |= 1 << 0;
+#endif
+#ifdef CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU1
+  config.idle_core_mask |= 1 << 1;
+#endif
+  esp_task_wdt_reconfigure(&config);
+#else
+  esp_task_wdt_init(WATCHDOG_TIMEOUT_S, true);
+#endif
+  esp_task_wdt_add(NULL);
+}
+
+void feedWatchdog() {
+  esp_task_wdt_reset();
+}
+
+const CrashReport* pendingCrashReport() {
+  return crash_report_pending ? &crash_report : NULL;
+}
+
+void crashReportSent() {
+  crash_report_pending = false;
+}
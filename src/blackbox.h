@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_system.h>
+
+//Crash-surviving event trace: the last BLACKBOX_RECORDS events in RTC memory (kept across every reset
+//but power-on), so the next boot can tell what a unit was doing when it hung or crashed.
+//Stages (telemetry send, DHT20 read, screen draw...) are bracketed with blackboxBegin()/blackboxEnd();
+//the task watchdog hook records which one stalled before the watchdog resets the chip.
+const int BLACKBOX_RECORDS = 128; //Power of two
+const int BLACKBOX_BYTE_BUDGET = 1100; //RTC slow memory allowed for the trace (the history has 5120 of 8 KB)
+const int WATCHDOG_TIMEOUT_S = 30; //Longer than a telemetry send can take with its own timeouts
+const int CRASH_REPORT_EVENTS = 16; //Last events of a crashed boot sent with the next telemetry (0: none)
+
+//Event IDs (an end record has BLACKBOX_END set)
+enum BlackboxEvent : uint16_t {
+  BB_IDLE, //Between stages
+  BB_BOOT, //arg: reset reason
+  BB_WIFI, //Stage: connecting to WiFi (setup)
+  BB_SETUP_DONE,
+  BB_TELEMETRY, //Stage: telemetry send
+  BB_DHT_REQUEST,
+  BB_DHT_READ, //Stage: DHT20 read over I2C
+  BB_DRAW, //Stage: screen draw, arg: screen
+  BB_BUTTON, //arg: pin
+  BB_COMMAND, //arg: length
+  BB_LAN_STREAM, //Stage: LAN stream update
+  BB_STALL, //Task watchdog fired, arg: stage in progress
+  BB_EVENT_COUNT
+};
+const uint16_t BLACKBOX_END = 0x8000;
+
+struct BlackboxRecord {
+  uint32_t time_us; //micros() when recorded
+  uint16_t event;
+  uint16_t arg;
+};
+
+//What the previous boot left in the trace, when it ended abnormally (panic, watchdog, brownout)
+struct CrashReport {
+  esp_reset_reason_t reason;
+  uint16_t stage; //Stage in progress when it ended
+  uint16_t stage_arg;
+  int count;
+  BlackboxRecord events[CRASH_REPORT_EVENTS > 0 ? CRASH_REPORT_EVENTS : 1]; //Oldest first, times relative to the last one
+};
+
+//Dump the previous boot's trace over Serial and start a new one (call after Serial.begin)
+void blackboxStart();
+
+void blackboxRecord(uint16_t event, uint16_t arg = 0);
+
+void blackboxBegin(BlackboxEvent stage, uint16_t arg = 0);
+
+void blackboxEnd(BlackboxEvent stage);
+
+//Watch the loop task: if it is not fed for WATCHDOG_TIMEOUT_S, record the stall and reset
+void startWatchdog();
+
+void feedWatchdog();
+
+const char* blackboxEventName(uint16_t event);
+
+const char* resetReasonName(esp_reset_reason_t reason);
+
+//Crash report waiting to go out with the telemetry (NULL if none), cleared once it was sent
+const CrashReport* pendingCrashReport();
+
+void crashReportSent();
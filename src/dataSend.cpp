@@ -1,8 +1,61 @@
 #include "dataSend.h"
+#include "blackbox.h"
 #include "private.h"
 
+#ifdef USE_MQTT
+#include <mqtt_client.h>
+#include <freertos/queue.h>
+#endif
+
 const int MAX_RETRY = 3;
 
+#ifdef USE_MQTT
+//MQTT session
+//private.h provides mqtt_uri ("mqtts://<hub>.azure-devices.net:8883" or "mqtt://<mosquitto-host>:1883"),
+//device_id and mqtt_username ("<hub>.azure-devices.net/<device_id>/?api-version=2021-04-12")
+const int MQTT_KEEPALIVE = 60; //Seconds
+const int COMMAND_QUEUE_LEN = 4;
+
+struct Command {
+  char payload[COMMAND_SIZE];
+};
+
+esp_mqtt_client_handle_t mqtt_client = NULL;
+QueueHandle_t command_queue = NULL;
+volatile bool mqtt_connected = false;
+String telemetry_topic;
+String command_topic;
+
+//Runs on the MQTT task: keep track of the session and hand cloud-to-device messages to the main loop
+void handleMqttEvent(void* args, esp_event_base_t base, int32_t event_id, void* event_data) {
+  esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t) event_data;
+
+  switch((esp_mqtt_event_id_t) event_id) {
+    case MQTT_EVENT_CONNECTED:
+      mqtt_connected = true;
+      //Persistent session keeps the subscription, but the broker may have dropped it
+      if(!event->session_present) {
+        esp_mqtt_client_subscribe(mqtt_client, command_topic.c_str(), 1);
+      }
+      break;
+    case MQTT_EVENT_DISCONNECTED:
+      mqtt_connected = false;
+      break;
+    case MQTT_EVENT_DATA:
+      //Only whole messages that fit in a command are accepted
+      if(event->current_data_offset == 0 && event->data_len == event->total_data_len && event->data_len < COMMAND_SIZE) {
+        Command command;
+        memcpy(command.payload, event->data, event->data_len);
+        command.payload[event->data_len] = '\0';
+        xQueueSend(command_queue, &command, 0);
+      }
+      break;
+    default:
+      break;
+  }
+}
+#endif
+
 void startWiFi() {
   WiFiManager manager;
   manager.setConfigPortalTimeout(180); //Timeout in 3 min
@@ -19,15 +72,96 @@ void startWiFi() {
     Serial.println("Unable to connect to WiFi, device starting without connection to Cloud");
 }
 
-void sendData(float temperature, float humidity, int brightness) {
-  //Create JSON payload
+//Open the telemetry session (nothing to do for HTTPS, which connects per sample)
+void startTelemetry() {
+#ifdef USE_MQTT
+  telemetry_topic = String("devices/") + device_id + "/messages/events/";
+  command_topic = String("devices/") + device_id + "/messages/devicebound/#";
+  command_queue = xQueueCreate(COMMAND_QUEUE_LEN, sizeof(Command));
+
+  esp_mqtt_client_config_t config = {};
+#if ESP_IDF_VERSION_MAJOR >= 5
+  config.broker.address.uri = mqtt_uri;
+  config.broker.verification.certificate = root_ca;
+  config.credentials.client_id = device_id;
+  config.credentials.username = mqtt_username;
+  config.credentials.authentication.password = SAS_TOKEN;
+  config.session.keepalive = MQTT_KEEPALIVE;
+  config.session.disable_clean_session = true;
+#else
+  config.uri = mqtt_uri;
+  config.cert_pem = root_ca;
+  config.client_id = device_id;
+  config.username = mqtt_username;
+  config.password = SAS_TOKEN;
+  config.keepalive = MQTT_KEEPALIVE;
+  config.disable_clean_session = true;
+#endif
+
+  mqtt_client = esp_mqtt_client_init(&config);
+  esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_ANY, handleMqttEvent, NULL);
+  esp_mqtt_client_start(mqtt_client); //Reconnects on its own from here on
+  Serial.println("MQTT session starting: " + String(mqtt_uri));
+#endif
+}
+
+//Add a channel's window aggregates to the payload
+void addStats(JsonObject object, const RunningStats& stats) {
+  object["min"] = stats.min_val;
+  object["max"] = stats.max_val;
+  object["mean"] = stats.mean;
+  object["var"] = stats.variance();
+  object["n"] = stats.count;
+}
+
+//Add what the last boot was doing when it crashed: reset reason, stalled stage and its last events
+//as [microseconds before the end, event, arg]
+void addCrashReport(JsonObject object, const CrashReport& report) {
+  object["reason"] = resetReasonName(report.reason);
+  object["stage"] = blackboxEventName(report.stage);
+  object["stageArg"] = report.stage_arg;
+  JsonArray events = object["events"].to<JsonArray>();
+  for(int i = 0; i < report.count; ++i) {
+    JsonArray event = events.add<JsonArray>();
+    event.add(report.events[i].time_us);
+    event.add(report.events[i].event);
+    event.add(report.events[i].arg);
+  }
+}
+
+void sendData(float temperature, float humidity, int brightness, const SensorWindow& window) {
+  //Create JSON payload: latest readings plus aggregates of every sample since the last send
   ArduinoJson::JsonDocument doc;
   doc["temperature"] = temperature;
   doc["humidity"] = humidity;
   doc["brightness"] = brightness;
-  char buffer[256];
-  serializeJson(doc, buffer, sizeof(buffer));
+  JsonObject stats = doc["window"].to<JsonObject>();
+  stats["ms"] = millis() - window.start;
+  addStats(stats["temperature"].to<JsonObject>(), window.temperature);
+  addStats(stats["humidity"].to<JsonObject>(), window.humidity);
+  addStats(stats["brightness"].to<JsonObject>(), window.brightness);
+  //Sent until a send succeeds
+  const CrashReport* crash = pendingCrashReport();
+  if(crash) {
+    addCrashReport(doc["crash"].to<JsonObject>(), *crash);
+  }
+  char buffer[1024];
+  size_t length = serializeJson(doc, buffer, sizeof(buffer));
 
+#ifdef USE_MQTT
+  //Send telemetry over the open session; the MQTT task does the actual write
+  if(!mqtt_connected) {
+    Serial.println("Failed to send telemetry. MQTT not connected");
+    return;
+  }
+  if(esp_mqtt_client_enqueue(mqtt_client, telemetry_topic.c_str(), buffer, length, MQTT_QOS, 0, true) >= 0) {
+    Serial.println("Telemetry sent: " + String(buffer));
+    crashReportSent();
+  }
+  else {
+    Serial.println("Failed to send telemetry. MQTT outbox full");
+  }
+#else
   //Send telemetry via HTTPS
   WiFiClientSecure client;
   client.setCACert(root_ca); //Set root CA certificate
@@ -35,13 +169,28 @@ void sendData(float temperature, float humidity, int brightness) {
   http.begin(client, url);
   http.addHeader("Content-Type", "application/json");
   http.addHeader("Authorization", SAS_TOKEN);
-  int httpCode = http.POST(buffer);
+  int httpCode = http.POST((uint8_t*) buffer, length);
 
   if (httpCode == 204) { //IoT Hub returns 204 (No Content) for successful telemetry
     Serial.println("Telemetry sent: " + String(buffer));
+    crashReportSent();
   }
   else {
     Serial.println("Failed to send telemetry. HTTP code: " + String(httpCode));
   }
   http.end();
-}
\ No newline at end of file
+#endif
+}
+
+//Copy the next pending cloud-to-device message into buffer, returns false if there is none
+//Only the MQTT transport receives messages
+bool receiveCommand(char* buffer, size_t size) {
+#ifdef USE_MQTT
+  Command command;
+  if(command_queue != NULL && xQueueReceive(command_queue, &command, 0) == pdTRUE) {
+    strlcpy(buffer, command.payload, size);
+    return true;
+  }
+#endif
+  return false;
+}
@@ -4,7 +4,21 @@
 #include <WiFiClient.h>
 #include <WiFiManager.h>
 #include <ArduinoJson.h>
+#include "stats.h"
+
+//Telemetry transport: HTTPS POST by default
+//Build with -DUSE_MQTT to keep a persistent MQTT/TLS session to IoT Hub (or a local Mosquitto broker) instead
+#ifndef MQTT_QOS
+#define MQTT_QOS 1 //QoS used to publish telemetry (0 or 1)
+#endif
+
+//Largest cloud-to-device message handed to the main loop
+const int COMMAND_SIZE = 256;
 
 void startWiFi();
 
-void sendData(float temperature, float humidity, int brightness);
\ No newline at end of file
+void startTelemetry();
+
+void sendData(float temperature, float humidity, int brightness, const SensorWindow& window);
+
+bool receiveCommand(char* buffer, size_t size);
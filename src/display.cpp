@@ -1,10 +1,86 @@
 #include "display.h"
 
+#ifndef TFT_BL
+#define TFT_BL 4 //TTGO T-Display backlight
+#endif
+
 //Initialize the display
 void ManageDisplays::start() {
     display.init();
     display.setRotation(3);
     display.fillScreen(TFT_BLACK);
+
+    //Backlight on a PWM channel so it can be dimmed
+    ledc_timer_config_t timer = {};
+    timer.speed_mode = BACKLIGHT_MODE;
+    timer.duty_resolution = LEDC_TIMER_8_BIT;
+    timer.timer_num = BACKLIGHT_TIMER;
+    timer.freq_hz = 5000;
+    timer.clk_cfg = LEDC_AUTO_CLK;
+    ledc_timer_config(&timer);
+
+    ledc_channel_config_t channel = {};
+    channel.gpio_num = TFT_BL;
+    channel.speed_mode = BACKLIGHT_MODE;
+    channel.channel = BACKLIGHT_CHANNEL;
+    channel.timer_sel = BACKLIGHT_TIMER;
+    channel.intr_type = LEDC_INTR_DISABLE;
+    channel.duty = BACKLIGHT_FULL;
+    channel.hpoint = 0;
+    ledc_channel_config(&channel);
+    ledc_fade_func_install(0); //Already installed is fine
+
+    last_activity = millis();
+}
+
+//Register activity: restore full backlight, powering the panel back up if it was off
+//Returns true if the panel was off, so the caller has to redraw the screen
+bool ManageDisplays::wake() {
+    last_activity = millis();
+    if(power_state == AWAKE) {
+        return false;
+    }
+
+    bool was_off = power_state == PANEL_OFF;
+    if(was_off) {
+        display.writecommand(TFT_SLPOUT);
+        delay(5); //Panel needs 5ms after sleep out before the next command
+        display.writecommand(TFT_DISPON);
+    }
+    setBacklight(BACKLIGHT_FULL, 0);
+    power_state = AWAKE;
+    return was_off;
+}
+
+//Dim the backlight after DIM_TIMEOUT and turn the panel off after OFF_TIMEOUT without activity
+void ManageDisplays::updateIdle() {
+    unsigned long idle = millis() - last_activity;
+
+    if(power_state == AWAKE && idle >= DIM_TIMEOUT) {
+        setBacklight(BACKLIGHT_DIM, BACKLIGHT_FADE_MS);
+        power_state = DIMMED;
+    }
+    else if(power_state == DIMMED && idle >= OFF_TIMEOUT) {
+        setBacklight(0, 0);
+        display.writecommand(TFT_DISPOFF);
+        display.writecommand(TFT_SLPIN);
+        power_state = PANEL_OFF;
+    }
+}
+
+//True while the panel is off and nothing should be drawn
+bool ManageDisplays::isOff() const {
+    return power_state == PANEL_OFF;
+}
+
+void ManageDisplays::setBacklight(int level, int fade_ms) {
+    if(fade_ms > 0) {
+        ledc_set_fade_with_time(BACKLIGHT_MODE, BACKLIGHT_CHANNEL, level, fade_ms);
+        ledc_fade_start(BACKLIGHT_MODE, BACKLIGHT_CHANNEL, LEDC_FADE_NO_WAIT);
+    }
+    else {
+        ledc_set_duty_and_update(BACKLIGHT_MODE, BACKLIGHT_CHANNEL, level, 0); //Also cancels a running fade
+    }
 }
 
 //Print to display the home screen
@@ -20,14 +96,14 @@ void ManageDisplays::drawHome(int timer_duration, unsigned long timer_start, boo
         //No timers active
         display.print(no_alarm_face);
     }
-    else if(now - timer_start >= timer_duration) {
+    else if(now - timer_start >= (unsigned long) timer_duration) {
         //Timer is going off
         time_remaining = "0:00:00";
         display.print(alarm_face);
     }
     else {
         unsigned long remaining = timer_duration - (now - timer_start);
-        if(remaining <= (timer_duration / 10)) {
+        if(remaining <= (unsigned long) (timer_duration / 10)) {
             //Getting closer to timer going off
             display.print(rushing_face);
         }
@@ -52,12 +128,12 @@ void ManageDisplays::drawMenu(int position) {
     display.fillScreen(TFT_BLACK);
     display.setTextSize(1);
 
-    for (int i = 0; i < 5; ++i) {
-        int y = 15 + i * 22;
+    for (int i = 0; i < MENU_ITEMS; ++i) {
+        int y = 12 + i * 18;
 
         if (i == position) {
             //If at selected position, add ">" and highlight menu
-            display.fillRect(0, y - 10, 240, 25, TFT_DARKGREY);
+            display.fillRect(0, y - 6, 240, 20, TFT_DARKGREY);
             display.setTextColor(TFT_WHITE, TFT_DARKGREY);
             display.setCursor(14, y);
             display.print(">");
@@ -268,6 +344,100 @@ void ManageDisplays::drawLightBulb(int brightness) {
     drawLeftArrow();
 }
 
+//Print to display sparklines of the telemetry history (temperature, humidity, brightness)
+void ManageDisplays::drawTrends(const TelemetryHistory& history) {
+    //Clear Screen
+    display.fillScreen(TFT_BLACK);
+
+    //Columns are fixed to time slots and swept left to right, so only the newest one changes per sample
+    uint32_t window = TREND_COLUMNS * TREND_SAMPLES_PER_COLUMN;
+    uint32_t start = history.count() > window ? history.count() - window : 0;
+    start -= start % TREND_SAMPLES_PER_COLUMN;
+    for(uint32_t seq = start; seq < history.count(); seq += TREND_SAMPLES_PER_COLUMN) {
+        drawTrendColumn(history, seq);
+    }
+
+    drawTrendUpdate(history);
+}
+
+//Redraw only the column holding the newest sample
+void ManageDisplays::drawTrendUpdate(const TelemetryHistory& history) {
+    if(history.count() == 0) {
+        drawTrendLabels(history);
+        drawLeftArrow();
+        return;
+    }
+
+    uint32_t newest = history.count() - 1;
+    drawTrendColumn(history, newest - newest % TREND_SAMPLES_PER_COLUMN);
+
+    //Cursor marking the sweep position
+    int cursor = (newest / TREND_SAMPLES_PER_COLUMN + 1) % TREND_COLUMNS;
+    for(int row = 0; row < 3; ++row) {
+        display.drawFastVLine(cursor, row * TREND_ROW_HEIGHT + 9, TREND_PLOT_HEIGHT, TFT_DARKGREY);
+    }
+
+    drawTrendLabels(history);
+    drawLeftArrow();
+}
+
+//Draw the min-max range of the samples in one column for each channel
+void ManageDisplays::drawTrendColumn(const TelemetryHistory& history, uint32_t start) {
+    const float low[3] = {15, 0, 0}; //Same temperature scale as the thermometer
+    const float high[3] = {35, 100, 4095};
+    const uint16_t colors[3] = {TFT_RED, TFT_BLUE, GOLDISH};
+
+    float min_val[3] = {high[0], high[1], high[2]};
+    float max_val[3] = {low[0], low[1], low[2]};
+    bool found = false;
+
+    for(uint32_t seq = start; seq < start + TREND_SAMPLES_PER_COLUMN; ++seq) {
+        HistorySample sample;
+        if(!history.get(seq, sample)) {
+            continue;
+        }
+        float value[3] = {sample.temperature, sample.humidity, (float) sample.brightness};
+        for(int row = 0; row < 3; ++row) {
+            float clamped = constrain(value[row], low[row], high[row]);
+            min_val[row] = min(min_val[row], clamped);
+            max_val[row] = max(max_val[row], clamped);
+        }
+        found = true;
+    }
+
+    int x = (start / TREND_SAMPLES_PER_COLUMN) % TREND_COLUMNS;
+    for(int row = 0; row < 3; ++row) {
+        int top = row * TREND_ROW_HEIGHT + 9;
+        display.drawFastVLine(x, top, TREND_PLOT_HEIGHT, TFT_BLACK);
+        if(found) {
+            int y_high = top + TREND_PLOT_HEIGHT - 1 - (max_val[row] - low[row]) * (TREND_PLOT_HEIGHT - 1) / (high[row] - low[row]);
+            int y_low = top + TREND_PLOT_HEIGHT - 1 - (min_val[row] - low[row]) * (TREND_PLOT_HEIGHT - 1) / (high[row] - low[row]);
+            display.drawFastVLine(x, y_high, y_low - y_high + 1, colors[row]);
+        }
+    }
+}
+
+//Latest value above each sparkline
+void ManageDisplays::drawTrendLabels(const TelemetryHistory& history) {
+    const char* names[3] = {"Temp 24h: ", "Humidity 24h: ", "Brightness 24h: "};
+    String values[3] = {"--", "--", "--"};
+
+    HistorySample sample;
+    if(history.count() > 0 && history.get(history.count() - 1, sample)) {
+        values[0] = String(sample.temperature, 1) + "C";
+        values[1] = String(sample.humidity, 1) + "%";
+        values[2] = String(sample.brightness);
+    }
+
+    display.setTextSize(1);
+    for(int row = 0; row < 3; ++row) {
+        display.fillRect(0, row * TREND_ROW_HEIGHT, 240, 8, TFT_BLACK);
+        display.setCursor(2, row * TREND_ROW_HEIGHT);
+        display.print(names[row]);
+        display.print(values[row]);
+    }
+}
+
 //Backward Icon
 void ManageDisplays::drawLeftArrow() {
     display.setCursor(5, 120);
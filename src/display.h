@@ -2,7 +2,9 @@
 #include <Arduino.h>
 #include <TFT_eSPI.h>
 #include <Wire.h>
+#include <driver/ledc.h>
 #include "droplet.h"
+#include "history.h"
 
 //Enumerate menu types
 enum MenuType {
@@ -47,6 +49,10 @@ class ManageDisplays {
 
         void drawLightBulb(int brightness);
 
+        void drawTrends(const TelemetryHistory& history);
+
+        void drawTrendUpdate(const TelemetryHistory& history);
+
         void drawLeftArrow();
 
         void drawRightArrow();
@@ -54,11 +60,41 @@ class ManageDisplays {
         void drawDefaultText();
 
         String getTime(unsigned long ms);
+
+        bool wake();
+
+        void updateIdle();
+
+        bool isOff() const;
     
     private:
+        void drawTrendColumn(const TelemetryHistory& history, uint32_t start);
+
+        void drawTrendLabels(const TelemetryHistory& history);
+
         TFT_eSPI display = TFT_eSPI();
         TFT_eSprite droplet = TFT_eSprite(&display);
 
+        //Idle handling: dim the backlight, then turn the panel off
+        enum PowerState {
+          AWAKE,
+          DIMMED,
+          PANEL_OFF
+        };
+        PowerState power_state = AWAKE;
+        unsigned long last_activity = 0; //Last button press or active reminder
+
+        static const unsigned long DIM_TIMEOUT = 30000; //Dim after 30 seconds idle
+        static const unsigned long OFF_TIMEOUT = 300000; //Turn off after 5 minutes idle
+        static const int BACKLIGHT_FULL = 255;
+        static const int BACKLIGHT_DIM = 32;
+        static const int BACKLIGHT_FADE_MS = 500;
+        static const ledc_mode_t BACKLIGHT_MODE = LEDC_LOW_SPEED_MODE;
+        static const ledc_channel_t BACKLIGHT_CHANNEL = LEDC_CHANNEL_5;
+        static const ledc_timer_t BACKLIGHT_TIMER = LEDC_TIMER_3;
+
+        void setBacklight(int level, int fade_ms);
+
         //Dimentions of droplet sprite
         const int droplet_x = 40;
         const int droplet_y = 50;
@@ -69,8 +105,16 @@ class ManageDisplays {
         const uint16_t LIGHT_YELLOW = 0xFFE0; //Somewhat bright
         const uint16_t PALE_YELLOW = 0xFFF0; //Not very bright
 
-        const char* menuItems[5] = {"View Temp/Humidity", 
+        //Trend sparklines: 24 h of history swept across the screen, one column per 6 samples
+        static const int TREND_COLUMNS = 240;
+        static const int TREND_SAMPLES_PER_COLUMN = 6;
+        static const int TREND_ROW_HEIGHT = 40; //Label line + plot
+        static const int TREND_PLOT_HEIGHT = 30;
+
+        static const int MENU_ITEMS = 6;
+        const char* menuItems[MENU_ITEMS] = {"View Temp/Humidity", 
                                     "View Brightness",
+                                    "View Trends",
                                     "Set Stretch Break",
                                     "Set Water Break",
                                     "Set Brightness"};
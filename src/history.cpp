@@ -0,0 +1,88 @@
+#include "history.h"
+#include <esp_attr.h>
+#include <esp_system.h>
+
+const uint32_t HISTORY_MAGIC = 0x48495354; //"HIST"
+
+//Kept out of .bss so it is not cleared on reset
+RTC_NOINIT_ATTR HistoryStore history_store;
+
+//Clamp a change to what fits in a delta
+int8_t toDelta(int change) {
+  return constrain(change, -127, 127);
+}
+
+//Keep history from before a reset, unless the device lost power or the store is not initialized
+void TelemetryHistory::begin() {
+  if(esp_reset_reason() == ESP_RST_POWERON || history_store.magic != HISTORY_MAGIC) {
+    memset(&history_store, 0, sizeof(history_store));
+    history_store.magic = HISTORY_MAGIC;
+  }
+}
+
+//Append a sample, overwriting the oldest hour once the store is full
+void TelemetryHistory::push(float temperature, float humidity, int brightness) {
+  int16_t value[3] = {
+    (int16_t) lround(temperature / HISTORY_TEMP_STEP),
+    (int16_t) lround(constrain(humidity, 0, 100) / HISTORY_HUM_STEP),
+    (int16_t) constrain(brightness, 0, 4095)
+  };
+
+  HistoryBlock& block = history_store.blocks[(history_store.count / HISTORY_BLOCK_LEN) % HISTORY_BLOCKS];
+  int offset = history_store.count % HISTORY_BLOCK_LEN;
+
+  if(offset == 0) {
+    block.temperature = value[0];
+    block.humidity = value[1];
+    block.brightness = value[2];
+    memcpy(history_store.last, value, sizeof(value));
+  }
+  else {
+    //Deltas are taken from the last stored value, so a clamped step catches up on the next samples
+    int8_t* delta = block.deltas[offset - 1];
+    delta[0] = toDelta(value[0] - history_store.last[0]);
+    delta[1] = toDelta(value[1] - history_store.last[1]);
+    delta[2] = toDelta((value[2] - history_store.last[2]) / HISTORY_BRI_STEP);
+    history_store.last[0] += delta[0];
+    history_store.last[1] += delta[1];
+    history_store.last[2] += delta[2] * HISTORY_BRI_STEP;
+  }
+  ++history_store.count;
+}
+
+//Oldest retained sample: the start of the block after the one being filled
+uint32_t TelemetryHistory::first() const {
+  uint32_t blocks = history_store.count / HISTORY_BLOCK_LEN;
+  if(blocks < HISTORY_BLOCKS) {
+    return 0;
+  }
+  return (blocks - (HISTORY_BLOCKS - 1)) * HISTORY_BLOCK_LEN;
+}
+
+uint32_t TelemetryHistory::count() const {
+  return history_store.count;
+}
+
+//Decode a sample from its block's first value and deltas
+bool TelemetryHistory::get(uint32_t seq, HistorySample& sample) const {
+  if(seq < first() || seq >= count()) {
+    return false;
+  }
+
+  const HistoryBlock& block = history_store.blocks[(seq / HISTORY_BLOCK_LEN) % HISTORY_BLOCKS];
+  int offset = seq % HISTORY_BLOCK_LEN;
+  int temperature = block.temperature;
+  int humidity = block.humidity;
+  int brightness = block.brightness;
+
+  for(int i = 0; i < offset; ++i) {
+    temperature += block.deltas[i][0];
+    humidity += block.deltas[i][1];
+    brightness += block.deltas[i][2] * HISTORY_BRI_STEP;
+  }
+
+  sample.temperature = temperature * HISTORY_TEMP_STEP;
+  sample.humidity = humidity * HISTORY_HUM_STEP;
+  sample.brightness = brightness;
+  return true;
+}
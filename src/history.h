@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+
+//Telemetry history: 24 h of 1 minute samples kept in RTC memory (survives resets other than power-on)
+//Samples are grouped in blocks of one hour: the first sample is stored whole, the rest as 8-bit deltas
+const int HISTORY_BLOCK_LEN = 60; //Samples per block (1 hour at 1 sample/min)
+const int HISTORY_BLOCKS = 25; //24 full hours + the block being filled
+const int HISTORY_BYTE_BUDGET = 5120; //RTC slow memory allowed for the history (of 8 KB)
+
+//Quantization of the stored values
+const float HISTORY_TEMP_STEP = 0.1; //Celsius
+const float HISTORY_HUM_STEP = 0.1; //Percent
+const int HISTORY_BRI_STEP = 16; //Raw ADC counts per delta step
+
+struct HistorySample {
+  float temperature;
+  float humidity;
+  int brightness;
+};
+
+struct HistoryBlock {
+  int16_t temperature; //First sample of the block in HISTORY_TEMP_STEP
+  uint16_t humidity; //First sample of the block in HISTORY_HUM_STEP
+  uint16_t brightness; //First sample of the block in raw ADC counts
+  int8_t deltas[HISTORY_BLOCK_LEN - 1][3]; //Change from the previous sample (temperature, humidity, brightness)
+};
+
+struct HistoryStore {
+  uint32_t magic; //Marks the store as initialized
+  uint32_t count; //Number of samples ever pushed
+  int16_t last[3]; //Last stored (quantized) sample, deltas are taken from it
+  HistoryBlock blocks[HISTORY_BLOCKS];
+};
+
+static_assert(sizeof(HistoryStore) <= HISTORY_BYTE_BUDGET, "Telemetry history exceeds its RTC memory budget");
+
+class TelemetryHistory {
+    public:
+        void begin();
+
+        void push(float temperature, float humidity, int brightness);
+
+        //Samples are numbered from 0 in push order, only [first(), count()) are retained
+        uint32_t first() const;
+
+        uint32_t count() const;
+
+        bool get(uint32_t seq, HistorySample& sample) const;
+};
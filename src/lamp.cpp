@@ -0,0 +1,80 @@
+#include "lamp.h"
+
+//Set up the LEDC timer, channel and hardware fade
+void LampController::begin(int pin) {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = MODE;
+  timer.duty_resolution = LEDC_TIMER_8_BIT;
+  timer.timer_num = TIMER;
+  timer.freq_hz = FREQUENCY;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = pin;
+  channel.speed_mode = MODE;
+  channel.channel = CHANNEL;
+  channel.timer_sel = TIMER;
+  channel.intr_type = LEDC_INTR_DISABLE;
+  channel.duty = 0;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+
+  ledc_fade_func_install(0); //Already installed is fine
+}
+
+//Manual level (brightness menu), turns auto mode off
+void LampController::set(int level) {
+  auto_mode = false;
+  fadeTo(level);
+}
+
+//Hand the lamp to the controller, starting from the current level
+void LampController::setAuto() {
+  if(!auto_mode) {
+    auto_mode = true;
+    integral = current;
+  }
+}
+
+bool LampController::isAuto() const {
+  return auto_mode;
+}
+
+int LampController::level() const {
+  return current;
+}
+
+//One controller period: filter the light reading, map it to a target level and step the PI controller towards it
+void LampController::update(int light) {
+  uint32_t start = micros();
+
+  if(!filter_ready) {
+    filtered = light;
+    filter_ready = true;
+  }
+  filtered += (light - filtered) * FILTER_ALPHA;
+
+  if(auto_mode) {
+    float target = (MAX_LIGHT - filtered) * MAX_LEVEL / MAX_LIGHT;
+    float error = target - current;
+    if(fabs(error) < DEADBAND) {
+      error = 0;
+    }
+
+    //Clamp the integral so it does not wind up while the lamp is saturated
+    integral = constrain(integral + KI * error, 0, MAX_LEVEL);
+    int output = constrain(lround(integral + KP * error), 0, MAX_LEVEL);
+    if(output != current) {
+      fadeTo(output);
+    }
+  }
+
+  profile.record(micros() - start);
+}
+
+void LampController::fadeTo(int level) {
+  current = constrain(level, 0, MAX_LEVEL);
+  ledc_set_fade_with_time(MODE, CHANNEL, current, FADE_MS);
+  ledc_fade_start(MODE, CHANNEL, LEDC_FADE_NO_WAIT);
+}
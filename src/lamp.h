@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include <driver/ledc.h>
+#include "profiler.h"
+
+//LED lamp driven by its own LEDC channel so level changes fade in hardware
+//In auto mode the lamp level follows the inverse of the (filtered) light sensor reading, darker room means brighter lamp,
+//and a PI controller tracks that target so the level moves smoothly instead of stepping
+class LampController {
+    public:
+        ProfileSection profile = {"lamp control", 0, 0, 0};
+
+        void begin(int pin);
+
+        void set(int level);
+
+        void setAuto();
+
+        bool isAuto() const;
+
+        int level() const;
+
+        void update(int light);
+
+    private:
+        static const ledc_mode_t MODE = LEDC_LOW_SPEED_MODE;
+        static const ledc_channel_t CHANNEL = LEDC_CHANNEL_4; //Clear of the channels tone() uses
+        static const ledc_timer_t TIMER = LEDC_TIMER_2;
+        static const int FREQUENCY = 5000; //Hz
+        static const int MAX_LEVEL = 255; //8-bit duty
+        static const int FADE_MS = 100; //Fade over one controller period, so the output ramps continuously
+
+        static const int MAX_LIGHT = 4095; //12-bit ADC
+
+        //Controller tuning (error in duty steps)
+        const float DEADBAND = 2; //Hysteresis: ignore errors smaller than this
+        const float KP = 0.1;
+        const float KI = 0.2;
+        const float FILTER_ALPHA = 0.2; //Low-pass filter on the light sensor
+
+        bool auto_mode = true;
+        bool filter_ready = false;
+        float filtered = 0;
+        float integral = 0;
+        int current = 0;
+
+        void fadeTo(int level);
+};
@@ -0,0 +1,112 @@
+#include "lanStream.h"
+
+#ifdef LAN_STREAM
+#include <ArduinoJson.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFi.h>
+
+const int LAN_STREAM_PORT = 80;
+const size_t LAN_FRAME_SIZE = 384;
+
+AsyncWebServer lan_server(LAN_STREAM_PORT);
+AsyncWebSocket lan_socket("/ws");
+
+//Latest frame for /state and for browsers that just connected (written by the loop, read by the AsyncTCP task)
+char lan_frame[LAN_FRAME_SIZE] = "{}";
+portMUX_TYPE lan_frame_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void copyLanFrame(char* buffer) {
+  taskENTER_CRITICAL(&lan_frame_lock);
+  memcpy(buffer, lan_frame, LAN_FRAME_SIZE);
+  taskEXIT_CRITICAL(&lan_frame_lock);
+}
+
+//Runs on the AsyncTCP task
+void handleLanSocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t length) {
+  if(type != WS_EVT_CONNECT) {
+    return; //Dashboard subscribe requests are ignored, there is only this device
+  }
+  if(server->count() > LAN_STREAM_MAX_CLIENTS) {
+    client->close(1013, "Too many clients");
+    return;
+  }
+
+  //Same protocol as the dashboard server: announce the device, then send its latest reading
+  char buffer[LAN_FRAME_SIZE];
+  snprintf(buffer, sizeof(buffer), "{\"Type\":\"devices\",\"DeviceIds\":[\"%s\"]}", WiFi.getHostname());
+  client->text(buffer);
+  copyLanFrame(buffer);
+  client->text(buffer);
+}
+#endif
+
+void startLanStream() {
+#ifdef LAN_STREAM
+  lan_socket.onEvent(handleLanSocketEvent);
+  lan_server.addHandler(&lan_socket);
+  lan_server.on("/state", HTTP_GET, [](AsyncWebServerRequest* request) {
+    char buffer[LAN_FRAME_SIZE];
+    copyLanFrame(buffer);
+    AsyncWebServerResponse* response = request->beginResponse(200, "application/json", buffer);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    request->send(response);
+  });
+  lan_server.begin();
+  Serial.println("LAN stream at ws://" + WiFi.localIP().toString() + "/ws");
+#endif
+}
+
+int lanStreamClients() {
+#ifdef LAN_STREAM
+  lan_socket.cleanupClients(LAN_STREAM_MAX_CLIENTS);
+  return lan_socket.count();
+#else
+  return 0;
+#endif
+}
+
+#ifdef LAN_STREAM
+void addReminder(JsonObject object, const LanReminder& reminder) {
+  object["on"] = reminder.on;
+  object["minutes"] = reminder.minutes;
+  object["remainingMs"] = reminder.remaining_ms;
+  object["due"] = reminder.due;
+}
+#endif
+
+void publishLanState(const LanState& state) {
+#ifdef LAN_STREAM
+  ArduinoJson::JsonDocument doc;
+  JsonObject data = doc["IotData"].to<JsonObject>();
+  data["temperature"] = state.temperature;
+  data["humidity"] = state.humidity;
+  data["brightness"] = state.brightness;
+  addReminder(data["stretch"].to<JsonObject>(), state.stretch);
+  addReminder(data["water"].to<JsonObject>(), state.water);
+  data["doNotDisturb"] = state.do_not_disturb;
+  doc["DeviceId"] = WiFi.getHostname();
+
+  //Serialize once into a shared buffer that every client's queue references (no copy per client);
+  //the library bounds each client's queue, so a browser that falls behind cannot exhaust the heap
+  size_t length = measureJson(doc);
+  if(length >= LAN_FRAME_SIZE) {
+    return;
+  }
+  AsyncWebSocketMessageBuffer* frame = lan_socket.makeBuffer(length);
+  if(frame == NULL) {
+    return;
+  }
+  serializeJson(doc, (char*) frame->get(), length + 1);
+
+  taskENTER_CRITICAL(&lan_frame_lock);
+  memcpy(lan_frame, frame->get(), length);
+  lan_frame[length] = '\0';
+  taskEXIT_CRITICAL(&lan_frame_lock);
+
+  //The buffer is released once every queue has sent it (do not touch it after this)
+  lan_socket.textAll(frame);
+#else
+  (void) state;
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+
+//Live readings for browsers on the same LAN, without the IoT Hub round trip
+//Build with -DLAN_STREAM (needs the ESPAsyncWebServer and AsyncTCP libraries) to serve
+//  ws://<device>/ws     one JSON frame per update: {"IotData": {...}, "DeviceId": "<hostname>"}
+//  http://<device>/state  the latest frame
+//The dashboard connects to it with ?device=<device address>. Sockets are served by the AsyncTCP
+//task, the main loop only builds the frame. Without -DLAN_STREAM these do nothing.
+const int LAN_STREAM_MAX_CLIENTS = 4;
+
+struct LanReminder {
+  bool on;
+  int minutes;
+  long remaining_ms; //Until the reminder is due (negative once it is)
+  bool due; //Notification waiting to be dismissed
+};
+
+struct LanState {
+  float temperature;
+  float humidity;
+  int brightness;
+  LanReminder stretch;
+  LanReminder water;
+  bool do_not_disturb;
+};
+
+void startLanStream();
+
+//Connected browsers (drops the oldest ones beyond LAN_STREAM_MAX_CLIENTS)
+int lanStreamClients();
+
+void publishLanState(const LanState& state);
@@ -4,11 +4,24 @@
 #include "display.h"
 #include <DHT20.h>
 #include <Wire.h>
+#include "history.h"
+#include "stats.h"
+#include "lamp.h"
+#include "profiler.h"
+#include "trace.h"
+#include "lanStream.h"
+#include "blackbox.h"
+#include "ota.h"
 
 //Interval
 const int TELEMETRY_INTERVAL = 5000; //Get data every 5 seconds
 const int NOTIF_INTERVAL = 1000; //Buzzer & LED goes on and off every second
 const int REMINDER_INTERVAL = 1000; //If on home page, update screen every second
+const unsigned long HISTORY_INTERVAL = 60000; //Store a history sample every minute
+const int LIGHT_SAMPLE_INTERVAL = 100; //Sample light sensor 10 times a second between sends
+const int TEMP_HUM_SAMPLE_INTERVAL = 1000; //Sample DHT20 every second (it needs ~80ms per measurement)
+const unsigned long PROFILE_INTERVAL = 10000; //Print profiler output every 10 seconds
+const int LAN_STREAM_INTERVAL = 500; //Stream readings to LAN browsers twice a second (while any are connected)
 
 //Display
 ManageDisplays display;
@@ -30,36 +43,39 @@ const int GREEN_PIN = 25; //Stretch Timer
 const int BLUE_PIN = 26; //Water Timer
 const int YELLOW_PIN = 27; //LED Light Source
 
+//LED lamp on YELLOW_PIN (auto-brightness controller + hardware fades)
+LampController lamp;
+
 //Buzzer
 const int BUZZER_PIN = 12;
 
 //Light Sensor
-const int MAX_BRIGHTNESS = 4095;
 const int MAX_LED_BRIGHTNESS = 255;
-const int MIN_BRIGHTNESS = 0;
 const int LIGHT_SENSOR_PIN = 36;
 
 //Temperature/Humidity Sensor
 DHT20 temp_hum_sensor;
 
 //Enumerated Screen Values 
-const int SCREEN_NUM = 6;
+const int SCREEN_NUM = 7;
 const int HOME = 0;
 const int MENU = 1;
 //Pages from the menu
 const int VIEW_TEMPHUM = 2;
 const int VIEW_BRI = 3;
-const int CHNG_S = 4;
-const int CHNG_W = 5;
-const int CHNG_B = 6;
+const int VIEW_TREND = 4;
+const int CHNG_S = 5;
+const int CHNG_W = 6;
+const int CHNG_B = 7;
 
 //Enumerated Values (Menu Page)
-const int MENU_NUM = 5;
+const int MENU_NUM = 6;
 const int MENU_V_TEMPHUM = 0;
 const int MENU_V_BRI = 1;
-const int MENU_CHNG_S = 2;
-const int MENU_CHNG_W = 3;
-const int MENU_CHNG_B = 4;
+const int MENU_V_TREND = 2;
+const int MENU_CHNG_S = 3;
+const int MENU_CHNG_W = 4;
+const int MENU_CHNG_B = 5;
 
 //Variables
 int curr_screen; //Keep track of screen number
@@ -75,12 +91,29 @@ bool buzzer_state; //Control whether buzzer should be on or off
 unsigned long home_timer = 0; //Keep track of when to update home screen
 unsigned long notif_timer = 0; //Keep track of the when the buzzer and LED should turn on/off
 unsigned long lastTelemetryTime = 0;
+unsigned long history_timer = 0; //Keep track of when to store the next history sample
+unsigned long light_sample_timer = 0; //Keep track of when to sample the light sensor (and step the lamp controller)
+unsigned long profile_timer = 0; //Keep track of when to print profiler output
+unsigned long temp_hum_sample_timer = 0; //Keep track of when to start the next DHT20 measurement
+bool temp_hum_measuring = false; //True: DHT20 measurement requested, waiting for the result
+unsigned long lan_stream_timer = 0; //Keep track of when to stream the next LAN update
 
 //Variables to store sensor data read
 float temperature = 0;
 float humidity = 0;
 int brightness = 0;
 
+//Last 24 h of sensor data (1 sample/min)
+TelemetryHistory history;
+
+//Aggregates of the samples taken since the last telemetry send
+SensorWindow sensor_window;
+
+//Profiled sections
+ProfileSection telemetry_profile = {"telemetry send", 0, 0, 0};
+ProfileSection lan_stream_profile = {"lan stream", 0, 0, 0};
+ProfileSection* const profile_sections[] = {&lamp.profile, &telemetry_profile, &lan_stream_profile};
+
 //Return time converted from minutes to ms
 unsigned long toMS(int minutes) {
   return minutes * 60000;
@@ -96,7 +129,11 @@ Menus closerTimer() {
 
 //Get current humidity and temperature
 void getTempHumData() {
-  if(temp_hum_sensor.read() == DHT20_OK) {
+  blackboxBegin(BB_DHT_READ);
+  int status = temp_hum_sensor.read();
+  blackboxEnd(BB_DHT_READ);
+  traceTempHum(status, temp_hum_sensor.getTemperature(), temp_hum_sensor.getHumidity());
+  if(status == DHT20_OK) {
       temperature = temp_hum_sensor.getTemperature();
       humidity = temp_hum_sensor.getHumidity();
   }
@@ -105,6 +142,38 @@ void getTempHumData() {
 //Get curent brightness
 void getLightData() {
   brightness = analogRead(LIGHT_SENSOR_PIN);
+  traceLight(brightness);
+}
+
+//Sample the sensors between telemetry sends and add the readings to the current window
+//DHT20 measurements are requested and collected on later loops instead of blocking for them
+void sampleSensors() {
+  if(millis() - light_sample_timer >= LIGHT_SAMPLE_INTERVAL) {
+    light_sample_timer = millis();
+    getLightData();
+    sensor_window.brightness.add(brightness);
+    lamp.update(brightness);
+  }
+
+  if(!temp_hum_measuring && millis() - temp_hum_sample_timer >= TEMP_HUM_SAMPLE_INTERVAL) {
+    temp_hum_sample_timer = millis();
+    blackboxRecord(BB_DHT_REQUEST);
+    temp_hum_measuring = temp_hum_sensor.requestData() == DHT20_OK;
+  }
+  else if(temp_hum_measuring && !temp_hum_sensor.isMeasuring()) {
+    temp_hum_measuring = false;
+    blackboxBegin(BB_DHT_READ);
+    temp_hum_sensor.readData();
+    int status = temp_hum_sensor.convert();
+    blackboxEnd(BB_DHT_READ);
+    traceTempHum(status, temp_hum_sensor.getTemperature(), temp_hum_sensor.getHumidity());
+    if(status == DHT20_OK) {
+      temperature = temp_hum_sensor.getTemperature();
+      humidity = temp_hum_sensor.getHumidity();
+      sensor_window.temperature.add(temperature);
+      sensor_window.humidity.add(humidity);
+    }
+  }
 }
 
 //Set default stretch timer
@@ -140,14 +209,12 @@ void setDefaultWaterTimer() {
   display.water_menu.timer = millis();
 }
 
-//Read current sensor value to set default brightness of LED pin (representing LED lamp)
+//Let the auto-brightness controller set the brightness of LED pin (representing LED lamp) from the light sensor
 void setDefaultLight() {
-  int inverted = MAX_BRIGHTNESS - brightness;
-  int mapped = map(inverted, MIN_BRIGHTNESS, MAX_BRIGHTNESS, MIN_BRIGHTNESS, MAX_LED_BRIGHTNESS);
-  //Round the mapped values to match the incrementation provided in the brightness menu
-  int rounded = (mapped + display.brightness_menu.increment / 2) / display.brightness_menu.increment * display.brightness_menu.increment;
+  lamp.setAuto();
+  //Round the controller's level to match the incrementation provided in the brightness menu
+  int rounded = (lamp.level() + display.brightness_menu.increment / 2) / display.brightness_menu.increment * display.brightness_menu.increment;
   display.brightness_menu.current = rounded;
-  analogWrite(YELLOW_PIN, rounded);
 }
 
 //Restart timer for next reminder
@@ -176,8 +243,172 @@ void resetTimer(Menus& item) {
   }
 }
 
+//Apply a reminder value received from the cloud: a number of minutes (0 turns it off) or "default"
+void applyRemoteReminder(Menus& item, JsonVariantConst value) {
+  if(value.is<const char*>() && strcmp(value.as<const char*>(), "default") == 0) {
+    item.isDefault = true;
+    item.isOn = true;
+    resetTimer(item);
+  }
+  else if(value.is<int>()) {
+    //Snap to the values selectable from the menu
+    int minutes = constrain(value.as<int>(), 0, item.max_val - item.increment);
+    item.current = minutes / item.increment * item.increment;
+    item.isOn = item.current != 0;
+    item.isDefault = false;
+    item.timer = millis();
+  }
+}
+
+//Handle cloud-to-device messages, e.g. {"stretch": 30, "water": "default", "brightness": 153, "doNotDisturb": false}
+//or {"otaUrl": "http://...", "otaSha256": "..."} (see ota.h)
+void handleRemoteCommands() {
+  char buffer[COMMAND_SIZE];
+  while(receiveCommand(buffer, sizeof(buffer))) {
+    traceCommand(buffer);
+    blackboxRecord(BB_COMMAND, strlen(buffer));
+    ArduinoJson::JsonDocument doc;
+    if(deserializeJson(doc, buffer)) {
+      Serial.println("Ignoring malformed command: " + String(buffer));
+      continue;
+    }
+    Serial.println("Command received: " + String(buffer));
+
+    if(!doc["stretch"].isNull()) {
+      applyRemoteReminder(display.stretch_menu, doc["stretch"]);
+      //The reminder was turned off or rescheduled, so stop its pending notification
+      if(stretch_notif) {
+        digitalWrite(GREEN_PIN, LOW);
+        stretch_notif = false;
+        if(!water_notif) {
+          noTone(BUZZER_PIN);
+        }
+      }
+      if(curr_screen == CHNG_S) {
+        display.drawReminderSetting(display.stretch_menu);
+      }
+    }
+    if(!doc["water"].isNull()) {
+      applyRemoteReminder(display.water_menu, doc["water"]);
+      //The reminder was turned off or rescheduled, so stop its pending notification
+      if(water_notif) {
+        digitalWrite(BLUE_PIN, LOW);
+        water_notif = false;
+        if(!stretch_notif) {
+          noTone(BUZZER_PIN);
+        }
+      }
+      if(curr_screen == CHNG_W) {
+        display.drawReminderSetting(display.water_menu);
+      }
+    }
+    if(!doc["brightness"].isNull()) {
+      JsonVariantConst value = doc["brightness"];
+      if(value.is<const char*>() && strcmp(value.as<const char*>(), "default") == 0) {
+        display.brightness_menu.isDefault = true;
+        setDefaultLight();
+      }
+      else if(value.is<int>()) {
+        int level = constrain(value.as<int>(), 0, MAX_LED_BRIGHTNESS);
+        display.brightness_menu.current = level / display.brightness_menu.increment * display.brightness_menu.increment;
+        display.brightness_menu.isDefault = false;
+        lamp.set(display.brightness_menu.current);
+      }
+      if(curr_screen == CHNG_B) {
+        display.drawLightSetting(display.brightness_menu);
+      }
+    }
+    if(doc["doNotDisturb"].is<bool>() && doc["doNotDisturb"].as<bool>() != doNotDisturb) {
+      doNotDisturb = doc["doNotDisturb"].as<bool>();
+      digitalWrite(RED_PIN, doNotDisturb ? HIGH : LOW);
+      if(!doNotDisturb) {
+        //Restart timers when doNotDistrub turned off
+        display.stretch_menu.timer = millis();
+        display.water_menu.timer = millis();
+      }
+    }
+    if(doc["otaUrl"].is<const char*>() && !requestOta(doc["otaUrl"].as<const char*>(), doc["otaSha256"].as<const char*>())) {
+      Serial.println("Ignoring update request: one is running, or otaSha256 is missing");
+    }
+  }
+}
+
+//Reminder state as streamed to LAN browsers
+LanReminder lanReminder(const Menus& item, bool due) {
+  long remaining = (long) (item.timer + toMS(item.current) - millis());
+  return {item.isOn, item.current, remaining, due};
+}
+
+//Stream the current readings and reminders to browsers on the LAN (only in -DLAN_STREAM builds)
+void streamLanState() {
+  if(lanStreamClients() == 0) {
+    return;
+  }
+  blackboxBegin(BB_LAN_STREAM);
+  uint32_t stream_start = micros();
+  LanState state = {
+    temperature,
+    humidity,
+    brightness,
+    lanReminder(display.stretch_menu, stretch_notif),
+    lanReminder(display.water_menu, water_notif),
+    doNotDisturb
+  };
+  publishLanState(state);
+  lan_stream_profile.record(micros() - stream_start);
+  blackboxEnd(BB_LAN_STREAM);
+}
+
+//Draw the whole current screen
+void drawScreen() {
+  blackboxBegin(BB_DRAW, curr_screen);
+  Menus temp = closerTimer();
+  switch(curr_screen) {
+    case HOME:
+      display.drawHome(toMS(temp.current), temp.timer, !doNotDisturb && (display.stretch_menu.isOn || display.water_menu.isOn));
+      break;
+    case MENU:
+      display.drawMenu(curr_menu);
+      break;
+    case VIEW_TEMPHUM:
+      display.drawThermometer(temperature);
+      display.drawDroplet(humidity);
+      break;
+    case VIEW_BRI:
+      display.drawLightBulb(brightness);
+      break;
+    case VIEW_TREND:
+      display.drawTrends(history);
+      break;
+    case CHNG_S:
+      display.drawReminderSetting(display.stretch_menu);
+      break;
+    case CHNG_W:
+      display.drawReminderSetting(display.water_menu);
+      break;
+    case CHNG_B:
+      display.drawLightSetting(display.brightness_menu);
+      break;
+  }
+  blackboxEnd(BB_DRAW);
+}
+
+//Any button press wakes the display, a press that turns the panel back on does nothing else
+bool wakeDisplay() {
+  if(display.wake()) {
+    drawScreen();
+    return true;
+  }
+  return false;
+}
+
 //Event Handlers -- Buttons
 void handleUpTap(Button2& b) {
+  blackboxRecord(BB_BUTTON, b.getPin());
+  if(wakeDisplay()) {
+    return;
+  }
+
   //If notif on, stop buzzer and led blinking
   if(stretch_notif || water_notif) {
     if(stretch_notif) {
@@ -245,7 +476,7 @@ void handleUpTap(Button2& b) {
     else if(curr_screen == CHNG_B) {
       //Increment Current Brightness Value
       display.brightness_menu.current = (display.brightness_menu.current + display.brightness_menu.increment) % display.brightness_menu.max_val;
-      analogWrite(YELLOW_PIN, display.brightness_menu.current);
+      lamp.set(display.brightness_menu.current);
       display.brightness_menu.isDefault = false;
       display.drawLightSetting(display.brightness_menu);
     }
@@ -253,6 +484,11 @@ void handleUpTap(Button2& b) {
 }
 
 void handleDownTap(Button2& b) {
+  blackboxRecord(BB_BUTTON, b.getPin());
+  if(wakeDisplay()) {
+    return;
+  }
+
   //If notif on, stop buzzer and led blinking
   if(stretch_notif || water_notif) {
     if(stretch_notif) {
@@ -324,7 +560,7 @@ void handleDownTap(Button2& b) {
     else if(curr_screen == CHNG_B) {
       //Increment Current Brightness Value
       display.brightness_menu.current = (display.brightness_menu.current + display.brightness_menu.max_val - display.brightness_menu.increment) % display.brightness_menu.max_val;
-      analogWrite(YELLOW_PIN, display.brightness_menu.current);
+      lamp.set(display.brightness_menu.current);
       display.brightness_menu.isDefault = false;
       display.drawLightSetting(display.brightness_menu);;
     }
@@ -332,6 +568,11 @@ void handleDownTap(Button2& b) {
 }
 
 void handleLeftTap(Button2& b) {
+  blackboxRecord(BB_BUTTON, b.getPin());
+  if(wakeDisplay()) {
+    return;
+  }
+
   //If notif on, stop buzzer and led blinking
   if(stretch_notif || water_notif) {
     if(stretch_notif) {
@@ -355,11 +596,10 @@ void handleLeftTap(Button2& b) {
     noTone(BUZZER_PIN);
   }
   else {
-    Menus temp = closerTimer();
     if(b.wasPressedFor() > 200) {
       //Long Press - Return to Home display
       curr_screen = HOME;
-      display.drawHome(toMS(temp.current), temp.timer, !doNotDisturb && (display.stretch_menu.isOn || display.water_menu.isOn));
+      drawScreen();
     }
     else {
       //Move through screens
@@ -374,35 +614,17 @@ void handleLeftTap(Button2& b) {
           break;
       }
 
-      switch(curr_screen) {
-        case HOME:
-          display.drawHome(toMS(temp.current), temp.timer, !doNotDisturb && (display.stretch_menu.isOn || display.water_menu.isOn));
-          break;
-        case MENU:
-          display.drawMenu(curr_menu);
-          break;
-        case VIEW_TEMPHUM:
-          display.drawThermometer(temperature);
-          display.drawDroplet(humidity);
-          break;
-        case VIEW_BRI:
-          display.drawLightBulb(brightness);
-          break;
-        case CHNG_S:
-          display.drawReminderSetting(display.stretch_menu);
-          break;
-        case CHNG_W:
-          display.drawReminderSetting(display.water_menu);
-          break;
-        case CHNG_B:
-          display.drawLightSetting(display.brightness_menu);
-          break;
-      }
+      drawScreen();
     }
   }
 }
 
 void handleRightTap(Button2& b) {
+  blackboxRecord(BB_BUTTON, b.getPin());
+  if(wakeDisplay()) {
+    return;
+  }
+
   //If notif on, stop buzzer and led blinking
   if(stretch_notif || water_notif) {
     if(stretch_notif) {
@@ -426,7 +648,6 @@ void handleRightTap(Button2& b) {
     noTone(BUZZER_PIN);
   }
   else {
-    Menus temp = closerTimer();
     //Move through screens
     switch(curr_screen) {
       case HOME:
@@ -440,6 +661,9 @@ void handleRightTap(Button2& b) {
           case MENU_V_BRI:
             curr_screen = VIEW_BRI;
             break;
+          case MENU_V_TREND:
+            curr_screen = VIEW_TREND;
+            break;
           case MENU_CHNG_S:
             curr_screen = CHNG_S;
             break;
@@ -453,30 +677,7 @@ void handleRightTap(Button2& b) {
         break;
       }
 
-    switch(curr_screen) {
-      case HOME:
-        display.drawHome(toMS(temp.current), temp.timer, !doNotDisturb && (display.stretch_menu.isOn || display.water_menu.isOn));
-        break;
-      case MENU:
-        display.drawMenu(curr_menu);
-        break;
-      case VIEW_TEMPHUM:
-        display.drawThermometer(temperature);
-        display.drawDroplet(humidity);
-        break;
-      case VIEW_BRI:
-        display.drawLightBulb(brightness);
-        break;
-      case CHNG_S:
-        display.drawReminderSetting(display.stretch_menu);
-        break;
-      case CHNG_W:
-        display.drawReminderSetting(display.water_menu);
-        break;
-      case CHNG_B:
-        display.drawLightSetting(display.brightness_menu);
-        break;
-    }
+    drawScreen();
   }
 }
 
@@ -485,17 +686,29 @@ void setup() {
   Wire.begin();
   delay(1000);
 
+  //Report what the previous boot was doing if it crashed, then start tracing this one
+  blackboxStart();
+
+  //A new firmware image is on trial until it reaches the home screen
+  startOtaTrial();
+
   //Start Temp/Humidity Sensor
   temp_hum_sensor.begin();
 
   //Start Wifi
+  blackboxBegin(BB_WIFI);
   startWiFi();
+  blackboxEnd(BB_WIFI);
+  startTelemetry();
+  startLanStream();
+  startOta();
 
   //Set up LED pins as outputs
   pinMode(RED_PIN, OUTPUT);
   pinMode(YELLOW_PIN, OUTPUT);
   pinMode(GREEN_PIN, OUTPUT);
   pinMode(BLUE_PIN, OUTPUT);
+  lamp.begin(YELLOW_PIN);
 
   //Initialize buzzer
   pinMode(BUZZER_PIN, OUTPUT);
@@ -523,6 +736,9 @@ void setup() {
   getTempHumData();
   getLightData();
 
+  //Keep history from before a reset
+  history.begin();
+
   //Set up timers
   setDefaultStretchTimer();
   setDefaultWaterTimer();
@@ -530,6 +746,12 @@ void setup() {
 
   home_timer = millis();
   notif_timer = millis();
+  history_timer = millis();
+  light_sample_timer = millis();
+  profile_timer = millis();
+  temp_hum_sample_timer = millis();
+  lan_stream_timer = millis();
+  sensor_window.reset();
 
   //Ensure usage of ms
   if(display.stretch_menu.current < display.water_menu.current) {
@@ -545,45 +767,90 @@ void setup() {
   water_led_state = false;
   buzzer_state = false;
   doNotDisturb = false;
+
+  //A new firmware image that got this far is kept
+  otaMarkHealthy();
+
+  //From here on a loop that stops coming back is recorded and reset
+  blackboxRecord(BB_SETUP_DONE);
+  startWatchdog();
 }
 
 void loop() {
+  feedWatchdog();
+
+  //Record button edges (only in -DTRACE_RECORD builds)
+  traceButton(LEFT_BUTTON_PIN);
+  traceButton(RIGHT_BUTTON_PIN);
+  traceButton(UP_BUTTON_PIN);
+  traceButton(DOWN_BUTTON_PIN);
+
   //Handle button clicks
   left_button.loop();
   right_button.loop();
   up_button.loop();
   down_button.loop();
 
+  //Handle remote reminder changes
+  handleRemoteCommands();
 
   //Get sensor data
-  if(millis() - lastTelemetryTime >= TELEMETRY_INTERVAL) {
-    getTempHumData();
-    getLightData();
+  sampleSensors();
 
+  if(millis() - lastTelemetryTime >= TELEMETRY_INTERVAL) {
     //Use default value for brightness if default is used
     if(display.brightness_menu.isDefault) {
       setDefaultLight();
     }
 
-    sendData(temperature, humidity, brightness);
+    blackboxBegin(BB_TELEMETRY);
+    uint32_t send_start = micros();
+    sendData(temperature, humidity, brightness, sensor_window);
+    telemetry_profile.record(micros() - send_start);
+    blackboxEnd(BB_TELEMETRY);
+    sensor_window.reset();
 
-    //Use data to update screen, if at data screens
-    switch(curr_screen) {
-      case VIEW_TEMPHUM:
-        display.drawThermometer(temperature);
-        display.drawDroplet(humidity);
-        break;
-      case VIEW_BRI:
-        display.drawLightBulb(brightness);
-        break;
-      case CHNG_B:
-        display.drawLightSetting(display.brightness_menu);
-        break;
+    //Use data to update screen, if at data screens (and the panel is on)
+    if(!display.isOff()) {
+      switch(curr_screen) {
+        case VIEW_TEMPHUM:
+          display.drawThermometer(temperature);
+          display.drawDroplet(humidity);
+          break;
+        case VIEW_BRI:
+          display.drawLightBulb(brightness);
+          break;
+        case CHNG_B:
+          display.drawLightSetting(display.brightness_menu);
+          break;
+      }
     }
 
     lastTelemetryTime = millis();
   }
 
+  //Stream to LAN browsers
+  if(millis() - lan_stream_timer >= LAN_STREAM_INTERVAL) {
+    lan_stream_timer = millis();
+    streamLanState();
+  }
+
+  //Print profiler output
+  if(millis() - profile_timer >= PROFILE_INTERVAL) {
+    printProfile(profile_sections, sizeof(profile_sections) / sizeof(profile_sections[0]), millis() - profile_timer);
+    profile_timer = millis();
+  }
+
+  //Store history sample
+  if(millis() - history_timer >= HISTORY_INTERVAL) {
+    history.push(temperature, humidity, brightness);
+    history_timer = millis();
+
+    if(curr_screen == VIEW_TREND && !display.isOff()) {
+      display.drawTrendUpdate(history);
+    }
+  }
+
   //Check for stretch break
   if((!doNotDisturb && display.stretch_menu.isOn) && millis() - display.stretch_menu.timer >= toMS(display.stretch_menu.current)) {
     stretch_notif = true;
@@ -594,6 +861,17 @@ void loop() {
     water_notif = true;
   }
 
+  //Restart into a downloaded and verified update when nobody is using the device and no reminder is due
+  if(otaUpdateReady() && !stretch_notif && !water_notif && (curr_screen == HOME || display.isOff())) {
+    restartForUpdate();
+  }
+
+  //Active reminders keep the display awake, otherwise dim it and turn it off when idle
+  if(stretch_notif || water_notif) {
+    wakeDisplay();
+  }
+  display.updateIdle();
+
   //If notification present, turn on/off buzzer & LED pins
   if((stretch_notif|| water_notif) && millis() - notif_timer >= NOTIF_INTERVAL) {
     notif_timer = millis();
@@ -615,14 +893,21 @@ void loop() {
     }
   }
   
-  //If on home page, update screen every second
+  //If on home page, update screen every second (no redraws while the panel is off)
+  if(display.isOff()) {
+    return;
+  }
   if(curr_screen == HOME && millis() - home_timer >= 1000 && (stretch_notif || water_notif)) {
+    blackboxBegin(BB_DRAW, HOME);
     display.drawHome(0, 0, true);
+    blackboxEnd(BB_DRAW);
     home_timer = millis();
   }
   else if(curr_screen == HOME && millis() - home_timer >= 1000) {
+    blackboxBegin(BB_DRAW, HOME);
     Menus temp = closerTimer();
     display.drawHome(toMS(temp.current), temp.timer, !doNotDisturb && (display.stretch_menu.isOn || display.water_menu.isOn));
+    blackboxEnd(BB_DRAW);
     home_timer = millis();
   }
 }
@@ -0,0 +1,377 @@
+#include "ota.h"
+
+#ifdef OTA_UPDATES
+#include <HTTPClient.h>
+#include <inttypes.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <mbedtls/sha256.h>
+#if __has_include(<esp32/rom/miniz.h>)
+#include <esp32/rom/miniz.h>
+#else
+#include <rom/miniz.h>
+#endif
+
+const int OTA_ATTEMPTS = 8; //Per update, each one resumes where the last one stopped
+const unsigned long OTA_RETRY_MS = 15000;
+const int OTA_CHUNK_SIZE = 1024; //Compressed bytes read at a time
+const int OTA_HTTP_TIMEOUT_MS = 15000;
+const int OTA_SECTOR_SIZE = 4096;
+const int OTA_URL_SIZE = 192;
+
+//NVS keys of the "ota" namespace: the update being downloaded ("url", "sha" and "next", the first
+//block not yet written), and for a new image that has not reached home yet, "image" (its partition
+//address) and "trial" (the number of times it booted)
+Preferences ota_prefs;
+
+char ota_url[OTA_URL_SIZE];
+uint8_t ota_sha256[32];
+TaskHandle_t ota_task = NULL;
+volatile bool ota_ready = false;
+bool ota_on_trial = false;
+esp_timer_handle_t ota_trial_timer = NULL;
+
+//Boot the other app partition again: the previous firmware, when this one is on trial
+void rollBack() {
+  const esp_partition_t* previous = esp_ota_get_next_update_partition(NULL);
+  ota_prefs.remove("trial");
+  ota_prefs.remove("image");
+  if(previous == NULL || esp_ota_set_boot_partition(previous) != ESP_OK) {
+    Serial.println("[ota] no previous image to roll back to");
+    return;
+  }
+  Serial.printf("[ota] rolling back to %s\n", previous->label);
+  esp_restart();
+}
+
+//Hung before reaching the home screen
+void handleTrialTimeout(void*) {
+  Serial.println("[ota] new image did not reach the home screen in time");
+  rollBack();
+}
+
+bool parseSha256(const char* hex, uint8_t* sha) {
+  if(hex == NULL || strlen(hex) != 64) {
+    return false;
+  }
+  for(int i = 0; i < 32; i++) {
+    char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+    char* end;
+    sha[i] = strtoul(byte, &end, 16);
+    if(*end != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool readFully(Stream& stream, uint8_t* buffer, size_t length) {
+  return stream.readBytes(buffer, length) == length;
+}
+
+//GET from offset to last (inclusive, 0 for the end of the container), 206 if the server took the range
+int requestRange(HTTPClient& http, uint32_t offset, uint32_t last) {
+  if(!http.begin(ota_url)) {
+    return -1;
+  }
+  http.setTimeout(OTA_HTTP_TIMEOUT_MS);
+  char range[32];
+  if(last > 0) {
+    snprintf(range, sizeof(range), "bytes=%" PRIu32 "-%" PRIu32, offset, last);
+  }
+  else {
+    snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", offset);
+  }
+  http.addHeader("Range", range);
+  return http.GET();
+}
+
+//Fetch the header and block table and check them against what was requested
+bool readContainerHeader(OtaHeader& header, OtaBlock* blocks) {
+  HTTPClient http;
+  int status = requestRange(http, 0, OTA_MAX_HEADER - 1);
+  bool ok = false;
+  if(status == HTTP_CODE_OK || status == HTTP_CODE_PARTIAL_CONTENT) {
+    Stream& stream = *http.getStreamPtr();
+    stream.setTimeout(OTA_HTTP_TIMEOUT_MS);
+    ok = readFully(stream, (uint8_t*) &header, sizeof(header)) &&
+      header.magic == OTA_MAGIC && header.version == OTA_VERSION &&
+      header.block_size > 0 && header.block_size <= OTA_MAX_BLOCK && header.block_size % OTA_SECTOR_SIZE == 0 &&
+      header.header_size == sizeof(header) + header.block_count * sizeof(OtaBlock) && header.header_size <= OTA_MAX_HEADER &&
+      (uint64_t) header.block_count * header.block_size >= header.image_size &&
+      memcmp(header.sha256, ota_sha256, sizeof(ota_sha256)) == 0 &&
+      readFully(stream, (uint8_t*) blocks, header.block_count * sizeof(OtaBlock));
+    if(!ok) {
+      Serial.println("[ota] not the requested image, or not a container");
+    }
+  }
+  else {
+    Serial.printf("[ota] header request failed: %d\n", status);
+  }
+  http.end();
+  return ok;
+}
+
+//Read one compressed block from the stream and inflate it into out (size bytes)
+bool inflateBlock(Stream& stream, const OtaBlock& block, uint8_t* out, size_t size, tinfl_decompressor* inflator, uint8_t* chunk) {
+  if(block.method == OTA_STORED) {
+    return block.length == size && readFully(stream, out, size);
+  }
+  if(block.method != OTA_DEFLATE) {
+    return false;
+  }
+
+  tinfl_init(inflator);
+  size_t out_pos = 0;
+  uint32_t remaining = block.length;
+  tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  while(remaining > 0 && status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+    size_t length = min((uint32_t) OTA_CHUNK_SIZE, remaining);
+    if(!readFully(stream, chunk, length)) {
+      return false;
+    }
+    remaining -= length;
+
+    //The whole block is the output buffer, so it is also the inflate window
+    size_t in_pos = 0;
+    do {
+      size_t in_bytes = length - in_pos;
+      size_t out_bytes = size - out_pos;
+      status = tinfl_decompress(inflator, chunk + in_pos, &in_bytes, out, out + out_pos, &out_bytes,
+        TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (remaining > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+      in_pos += in_bytes;
+      out_pos += out_bytes;
+    } while(status == TINFL_STATUS_HAS_MORE_OUTPUT && out_pos < size);
+  }
+  return status == TINFL_STATUS_DONE && remaining == 0 && out_pos == size;
+}
+
+//SHA-256 of what was written, read back from flash (a resumed download has no running hash to continue)
+bool verifyImage(const esp_partition_t* partition, uint32_t image_size, uint8_t* buffer) {
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  bool ok = true;
+  for(uint32_t offset = 0; offset < image_size && ok; offset += OTA_SECTOR_SIZE) {
+    uint32_t length = min((uint32_t) OTA_SECTOR_SIZE, image_size - offset);
+    ok = esp_partition_read(partition, offset, buffer, length) == ESP_OK;
+    mbedtls_sha256_update(&sha, buffer, length);
+  }
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  return ok && memcmp(digest, ota_sha256, sizeof(digest)) == 0;
+}
+
+void clearDownload() {
+  ota_prefs.remove("url");
+  ota_prefs.remove("sha");
+  ota_prefs.remove("next");
+}
+
+//One attempt: download the blocks not yet written and, once there are none left, verify and switch.
+//Returns true when done (switched, or failed for good), false to retry later.
+bool runUpdate(uint8_t* block_buffer, tinfl_decompressor* inflator, uint8_t* chunk) {
+  const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+  OtaHeader header;
+  static OtaBlock blocks[(OTA_MAX_HEADER - sizeof(OtaHeader)) / sizeof(OtaBlock)];
+  if(partition == NULL || WiFi.status() != WL_CONNECTED || !readContainerHeader(header, blocks)) {
+    return false;
+  }
+  if(header.image_size > partition->size) {
+    Serial.println("[ota] image does not fit the app partition");
+    clearDownload();
+    return true;
+  }
+
+  uint32_t next = ota_prefs.getUInt("next", 0);
+  if(next < header.block_count) {
+    Serial.printf("[ota] downloading blocks %" PRIu32 "-%" PRIu32 " of %" PRIu32 " to %s\n", next, header.block_count - 1, header.block_count, partition->label);
+    HTTPClient http;
+    int status = requestRange(http, blocks[next].offset, 0);
+    if(status != HTTP_CODE_PARTIAL_CONTENT && status != HTTP_CODE_OK) {
+      Serial.printf("[ota] download request failed: %d\n", status);
+      http.end();
+      return false;
+    }
+    Stream& stream = *http.getStreamPtr();
+    stream.setTimeout(OTA_HTTP_TIMEOUT_MS);
+    //A server that ignores ranges sends everything: skip what was already written
+    for(uint32_t skip = status == HTTP_CODE_OK ? blocks[next].offset : 0; skip > 0; ) {
+      size_t length = min((uint32_t) OTA_CHUNK_SIZE, skip);
+      if(!readFully(stream, chunk, length)) {
+        http.end();
+        return false;
+      }
+      skip -= length;
+    }
+
+    for(; next < header.block_count; next++) {
+      uint32_t offset = next * header.block_size;
+      size_t size = min(header.block_size, header.image_size - offset);
+      if(!inflateBlock(stream, blocks[next], block_buffer, size, inflator, chunk) ||
+        esp_rom_crc32_le(0, block_buffer, size) != blocks[next].crc32) {
+        Serial.printf("[ota] block %" PRIu32 " interrupted or corrupt\n", next);
+        http.end();
+        return false;
+      }
+      size_t erase = (size + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+      if(esp_partition_erase_range(partition, offset, erase) != ESP_OK ||
+        esp_partition_write(partition, offset, block_buffer, size) != ESP_OK) {
+        Serial.printf("[ota] flash write failed at block %" PRIu32 "\n", next);
+        http.end();
+        return false;
+      }
+      ota_prefs.putUInt("next", next + 1);
+    }
+    http.end();
+  }
+
+  bool ok = verifyImage(partition, header.image_size, block_buffer);
+  clearDownload();
+  if(!ok) {
+    Serial.println("[ota] SHA-256 mismatch, update discarded");
+    return true;
+  }
+  //Also checks the app image itself
+  if(esp_ota_set_boot_partition(partition) != ESP_OK) {
+    Serial.println("[ota] image rejected");
+    return true;
+  }
+  ota_prefs.putUInt("image", partition->address);
+  ota_prefs.putUChar("trial", 0);
+  ota_ready = true;
+  Serial.printf("[ota] update verified, boots from %s on the next restart\n", partition->label);
+  return true;
+}
+
+void runOtaTask(void*) {
+  uint8_t* block_buffer = (uint8_t*) malloc(OTA_MAX_BLOCK);
+  uint8_t* chunk = (uint8_t*) malloc(OTA_CHUNK_SIZE);
+  tinfl_decompressor* inflator = (tinfl_decompressor*) malloc(sizeof(tinfl_decompressor));
+  if(block_buffer != NULL && chunk != NULL && inflator != NULL) {
+    for(int attempt = 1; attempt <= OTA_ATTEMPTS && !runUpdate(block_buffer, inflator, chunk); attempt++) {
+      vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_MS));
+    }
+  }
+  else {
+    Serial.println("[ota] not enough memory");
+  }
+  free(block_buffer);
+  free(chunk);
+  free(inflator);
+  ota_task = NULL;
+  vTaskDelete(NULL);
+}
+
+bool startOtaTask() {
+  //Low priority, on the core the loop does not use: the download only fills idle time
+  return xTaskCreatePinnedToCore(runOtaTask, "ota", 8192, NULL, 1, &ota_task, 0) == pdPASS;
+}
+
+//Arduino marks a new image valid right at boot unless this returns true; it is marked once it reaches home
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+#endif
+
+void startOtaTrial() {
+#ifdef OTA_UPDATES
+  ota_prefs.begin("ota");
+
+  //A new image stays on trial until otaMarkHealthy(), unless the bootloader already went back to the old one
+  if(ota_prefs.isKey("trial") && ota_prefs.getUInt("image") != esp_ota_get_running_partition()->address) {
+    Serial.println("[ota] update was rolled back by the bootloader");
+    ota_prefs.remove("trial");
+    ota_prefs.remove("image");
+  }
+  if(ota_prefs.isKey("trial")) {
+    uint8_t boots = ota_prefs.getUChar("trial") + 1;
+    if(boots > OTA_TRIAL_BOOTS) {
+      Serial.println("[ota] new image failed to start");
+      rollBack();
+      return; //No previous image: keep running this one
+    }
+    ota_prefs.putUChar("trial", boots);
+    ota_on_trial = true;
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = handleTrialTimeout;
+    timer_args.name = "ota trial";
+    esp_timer_create(&timer_args, &ota_trial_timer);
+    esp_timer_start_once(ota_trial_timer, OTA_TRIAL_TIMEOUT_MS * 1000ULL);
+    Serial.printf("[ota] new image on trial, boot %u of %d\n", boots, OTA_TRIAL_BOOTS);
+  }
+#endif
+}
+
+void startOta() {
+#ifdef OTA_UPDATES
+  //Resume an interrupted download
+  if(ota_prefs.isKey("url") && ota_prefs.getBytes("sha", ota_sha256, sizeof(ota_sha256)) == sizeof(ota_sha256)) {
+    ota_prefs.getString("url", ota_url, sizeof(ota_url));
+    Serial.printf("[ota] resuming %s at block %" PRIu32 "\n", ota_url, ota_prefs.getUInt("next", 0));
+    startOtaTask();
+  }
+#endif
+}
+
+bool requestOta(const char* url, const char* sha256_hex) {
+#ifdef OTA_UPDATES
+  uint8_t sha[32];
+  if(ota_task != NULL || ota_ready || url == NULL || strlen(url) >= OTA_URL_SIZE || !parseSha256(sha256_hex, sha)) {
+    return false;
+  }
+  //A different image starts over, the same one carries on from the last block written
+  uint8_t stored[32];
+  if(ota_prefs.getBytes("sha", stored, sizeof(stored)) != sizeof(stored) || memcmp(stored, sha, sizeof(sha)) != 0) {
+    ota_prefs.putBytes("sha", sha, sizeof(sha));
+    ota_prefs.putUInt("next", 0);
+  }
+  memcpy(ota_sha256, sha, sizeof(sha));
+  strcpy(ota_url, url);
+  ota_prefs.putString("url", url);
+  return startOtaTask();
+#else
+  (void) url;
+  (void) sha256_hex;
+  return false;
+#endif
+}
+
+void otaMarkHealthy() {
+#ifdef OTA_UPDATES
+  if(!ota_on_trial) {
+    return;
+  }
+  ota_on_trial = false;
+  esp_timer_stop(ota_trial_timer);
+  ota_prefs.remove("trial");
+  ota_prefs.remove("image");
+  //With a rollback-enabled bootloader the image is also pending verification there
+  esp_ota_img_states_t state;
+  if(esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+    esp_ota_mark_app_valid_cancel_rollback();
+  }
+  Serial.println("[ota] new image reached the home screen, update kept");
+#endif
+}
+
+bool otaUpdateReady() {
+#ifdef OTA_UPDATES
+  return ota_ready;
+#else
+  return false;
+#endif
+}
+
+void restartForUpdate() {
+#ifdef OTA_UPDATES
+  Serial.println("[ota] restarting into the update");
+  Serial.flush();
+  esp_restart();
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+
+//Firmware updates over the air, from a block-compressed container built by tools/ota/pack.py
+//Build with -DOTA_UPDATES to enable (without it these do nothing). An update is started by the command
+//  {"otaUrl": "http://<host>/firmware.bota", "otaSha256": "<SHA-256 of the uncompressed image>"}
+//and runs in a background task: each block is fetched with an HTTP range request, inflated and
+//written to the inactive app partition, and the progress is kept in NVS so an interrupted download
+//(lost WiFi, reset) resumes at the next block. The image is checked against otaSha256 before the
+//device switches to it. A new image is on trial until it reaches the home screen: one that crashes
+//OTA_TRIAL_BOOTS times or hangs for OTA_TRIAL_TIMEOUT_MS is rolled back to the previous one.
+const uint32_t OTA_MAGIC = 0x41544F42; //"BOTA"
+const uint16_t OTA_VERSION = 1;
+const int OTA_MAX_HEADER = 4096; //Header and block table
+const uint32_t OTA_MAX_BLOCK = 32768; //Largest uncompressed block (the inflate window)
+const int OTA_TRIAL_BOOTS = 2;
+const unsigned long OTA_TRIAL_TIMEOUT_MS = 900000; //Includes startWiFi(), up to 3 config portals of 3 min
+
+//Container layout (little endian): OtaHeader, then block_count OtaBlocks, then the compressed blocks
+struct OtaHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size; //Header and block table, in bytes
+  uint32_t block_size; //Uncompressed bytes per block (the last one may be shorter), a multiple of 4 KB
+  uint32_t block_count;
+  uint32_t image_size;
+  uint8_t sha256[32]; //Of the uncompressed image
+  uint8_t reserved[12];
+};
+
+enum OtaMethod : uint32_t {
+  OTA_STORED,
+  OTA_DEFLATE //Raw deflate, each block on its own
+};
+
+struct OtaBlock {
+  uint32_t offset; //In the container
+  uint32_t length; //Compressed
+  uint32_t crc32; //Of the uncompressed block
+  uint32_t method;
+};
+
+static_assert(sizeof(OtaHeader) == 64, "OtaHeader must match tools/ota/pack.py");
+static_assert(sizeof(OtaBlock) == 16, "OtaBlock must match tools/ota/pack.py");
+
+//Count this boot if it is a trial of a new image (rolling back after too many), and arm the hang timer.
+//First thing in setup(), so a new image that fails anywhere before the home screen is caught
+void startOtaTrial();
+
+//Resume an interrupted download (after WiFi is up)
+void startOta();
+
+//Start downloading an update, returns false if one is already running or the request is malformed
+bool requestOta(const char* url, const char* sha256_hex);
+
+//The new image is fine: it reached the home screen
+void otaMarkHealthy();
+
+//A verified update is waiting for a restart
+bool otaUpdateReady();
+
+void restartForUpdate();
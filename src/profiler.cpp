@@ -0,0 +1,28 @@
+#include "profiler.h"
+#include <inttypes.h>
+
+void ProfileSection::record(uint32_t elapsed_us) {
+  ++calls;
+  total_us += elapsed_us;
+  max_us = max(max_us, elapsed_us);
+}
+
+//Print update rate, average/max cost and share of CPU time of each section, then start over
+void printProfile(ProfileSection* const sections[], int count, unsigned long elapsed_ms) {
+  if(elapsed_ms == 0) {
+    return;
+  }
+
+  for(int i = 0; i < count; ++i) {
+    ProfileSection& section = *sections[i];
+    float rate = section.calls * 1000.0 / elapsed_ms;
+    uint32_t average = section.calls > 0 ? section.total_us / section.calls : 0;
+    float cpu = section.total_us / (elapsed_ms * 10.0); //Percent of elapsed time
+
+    Serial.printf("[profile] %s: %.1f/s avg %" PRIu32 "us max %" PRIu32 "us cpu %.2f%%\n", section.name, rate, average, section.max_us, cpu);
+
+    section.calls = 0;
+    section.total_us = 0;
+    section.max_us = 0;
+  }
+}
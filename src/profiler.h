@@ -0,0 +1,14 @@
+#pragma once
+#include <Arduino.h>
+
+//Call rate and CPU time of a section of code, reset every time the profile is printed
+struct ProfileSection {
+  const char* name;
+  uint32_t calls;
+  uint32_t total_us;
+  uint32_t max_us;
+
+  void record(uint32_t elapsed_us);
+};
+
+void printProfile(ProfileSection* const sections[], int count, unsigned long elapsed_ms);
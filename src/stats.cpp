@@ -0,0 +1,36 @@
+#include "stats.h"
+
+void RunningStats::add(float value) {
+  ++count;
+  if(count == 1) {
+    min_val = value;
+    max_val = value;
+  }
+  else {
+    min_val = min(min_val, value);
+    max_val = max(max_val, value);
+  }
+  float delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+void RunningStats::reset() {
+  count = 0;
+  min_val = 0;
+  max_val = 0;
+  mean = 0;
+  m2 = 0;
+}
+
+//Sample variance, 0 until there are two samples
+float RunningStats::variance() const {
+  return count > 1 ? m2 / (count - 1) : 0;
+}
+
+void SensorWindow::reset() {
+  temperature.reset();
+  humidity.reset();
+  brightness.reset();
+  start = millis();
+}
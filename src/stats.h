@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+
+//Streaming min/max/mean/variance of a signal (Welford's algorithm), O(1) memory
+struct RunningStats {
+  uint32_t count = 0;
+  float min_val = 0;
+  float max_val = 0;
+  float mean = 0;
+  float m2 = 0; //Sum of squared differences from the mean
+
+  void add(float value);
+
+  void reset();
+
+  float variance() const;
+};
+
+//Aggregates of every sensor sample taken between two telemetry sends
+struct SensorWindow {
+  RunningStats temperature;
+  RunningStats humidity;
+  RunningStats brightness;
+  unsigned long start = 0; //When the window was opened (ms)
+
+  void reset();
+};
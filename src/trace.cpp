@@ -0,0 +1,52 @@
+#include "trace.h"
+
+#ifdef TRACE_RECORD
+const int TRACE_PINS = 40; //ESP32 GPIOs
+
+//Last level seen on each button pin, -1 until it is first read
+int8_t trace_levels[TRACE_PINS];
+bool trace_started = false;
+#endif
+
+void traceLight(int adc) {
+#ifdef TRACE_RECORD
+  Serial.printf("@%lu A %d\n", millis(), adc);
+#else
+  (void) adc;
+#endif
+}
+
+void traceTempHum(int status, float temperature, float humidity) {
+#ifdef TRACE_RECORD
+  Serial.printf("@%lu D %d %.2f %.2f\n", millis(), status, temperature, humidity);
+#else
+  (void) status;
+  (void) temperature;
+  (void) humidity;
+#endif
+}
+
+//Read a button pin and record it when its level changed (the first read is recorded too)
+void traceButton(int pin) {
+#ifdef TRACE_RECORD
+  if(!trace_started) {
+    memset(trace_levels, -1, sizeof(trace_levels));
+    trace_started = true;
+  }
+  int level = digitalRead(pin);
+  if(pin < TRACE_PINS && trace_levels[pin] != level) {
+    trace_levels[pin] = level;
+    Serial.printf("@%lu B %d %d\n", millis(), pin, level);
+  }
+#else
+  (void) pin;
+#endif
+}
+
+void traceCommand(const char* json) {
+#ifdef TRACE_RECORD
+  Serial.printf("@%lu C %s\n", millis(), json);
+#else
+  (void) json;
+#endif
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+
+//Input trace for the host replayer in tools/replay
+//Build with -DTRACE_RECORD and capture Serial: every input the loop sees is printed as one line
+//"@<ms> <event> <fields>" (other Serial output is skipped by the replayer). Without it these do nothing.
+//  @<ms> A <adc>                    light sensor reading
+//  @<ms> D <status> <temp> <hum>    DHT20 measurement (status 0 is DHT20_OK)
+//  @<ms> B <pin> <level>            button pin changed level (buttons are active low)
+//  @<ms> C <json>                   cloud-to-device command
+
+void traceLight(int adc);
+
+void traceTempHum(int status, float temperature, float humidity);
+
+void traceButton(int pin);
+
+void traceCommand(const char* json);
@@ -0,0 +1,46 @@
+"""The block-compressed firmware container read by src/ota.cpp (layout in src/ota.h).
+
+Every block of the image is compressed on its own (raw deflate), so a download can resume at any block
+and the device needs no more than one block of memory to inflate it.
+"""
+import struct
+import zlib
+
+MAGIC = 0x41544F42  # "BOTA"
+VERSION = 1
+HEADER = struct.Struct("<IHHIII32s12x")
+BLOCK = struct.Struct("<IIII")
+STORED, DEFLATE = 0, 1
+SECTOR_SIZE = 4096
+MAX_BLOCK = 32768
+MAX_HEADER = 4096
+
+
+def header_size(block_count):
+    return HEADER.size + block_count * BLOCK.size
+
+
+def parse_header(data):
+    """(block_size, image_size, sha256, blocks) from the start of a container, blocks as (offset, length, crc32, method)."""
+    magic, version, size, block_size, block_count, image_size, sha256 = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or size != header_size(block_count) or size > MAX_HEADER:
+        raise ValueError("not a firmware container")
+    if block_size == 0 or block_size > MAX_BLOCK or block_size % SECTOR_SIZE or block_count * block_size < image_size:
+        raise ValueError("bad block layout")
+    blocks = [BLOCK.unpack_from(data, HEADER.size + i * BLOCK.size) for i in range(block_count)]
+    return block_size, image_size, sha256, blocks
+
+
+def inflate_block(data, method, size):
+    if method == STORED:
+        block = data
+    elif method == DEFLATE:
+        inflator = zlib.decompressobj(-zlib.MAX_WBITS)
+        block = inflator.decompress(data, size)
+        if not inflator.eof or inflator.unconsumed_tail:
+            raise ValueError("truncated or oversized block")
+    else:
+        raise ValueError(f"unknown method {method}")
+    if len(block) != size:
+        raise ValueError("block has the wrong size")
+    return block
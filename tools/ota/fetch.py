@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Host stand-in for the device side of an update, the same steps src/ota.cpp takes: read the header,
+download the blocks not yet written with one range request, inflate and check each one, keep the
+progress in a state file, and verify the SHA-256 of the whole image at the end.
+
+    ./fetch.py http://localhost:8000/firmware.bota <sha256> -o partition.bin
+
+Run it again after an interruption (or with --retries) and it resumes at the next block.
+"""
+import argparse
+import hashlib
+import json
+import os
+import time
+import urllib.request
+import zlib
+
+import bota
+
+
+def request_range(url, offset, timeout, last=""):
+    request = urllib.request.Request(url, headers={"Range": f"bytes={offset}-{last}"})
+    response = urllib.request.urlopen(request, timeout=timeout)
+    if response.status == 200 and offset > 0:
+        # The server ignored the range: skip what was already written
+        response.read(offset)
+    return response
+
+
+def read_fully(response, length):
+    data = response.read(length)
+    if len(data) != length:
+        raise ConnectionError("connection closed mid-block")
+    return data
+
+
+def run_update(args, sha256, state):
+    """One attempt, True once the image is written and verified."""
+    with request_range(args.url, 0, args.timeout, bota.MAX_HEADER - 1) as response:
+        head = response.read(bota.MAX_HEADER)
+    block_size, image_size, image_sha256, blocks = bota.parse_header(head)
+    if image_sha256 != sha256:
+        raise ValueError("not the requested image")
+
+    if state.get("sha256") != sha256.hex():
+        state.update(sha256=sha256.hex(), next=0)
+    next_block = state["next"]
+    mode = "r+b" if next_block > 0 and os.path.exists(args.output) else "w+b"
+    with open(args.output, mode) as partition:
+        if next_block < len(blocks):
+            print(f"downloading blocks {next_block}-{len(blocks) - 1} of {len(blocks)}")
+            downloaded = 0
+            with request_range(args.url, blocks[next_block][0], args.timeout) as response:
+                for index in range(next_block, len(blocks)):
+                    offset, length, crc32, method = blocks[index]
+                    size = min(block_size, image_size - index * block_size)
+                    block = bota.inflate_block(read_fully(response, length), method, size)
+                    if zlib.crc32(block) != crc32:
+                        raise ValueError(f"block {index} is corrupt")
+                    partition.seek(index * block_size)
+                    partition.write(block)
+                    partition.flush()
+                    downloaded += length
+                    state["next"] = index + 1
+                    save_state(args.state, state)
+            print(f"downloaded {downloaded} bytes for {image_size - next_block * block_size} bytes of image")
+
+        partition.truncate(image_size)
+        partition.seek(0)
+        if hashlib.sha256(partition.read()).digest() != sha256:
+            state.clear()
+            save_state(args.state, state)
+            raise SystemExit("SHA-256 mismatch, update discarded")
+    state.clear()
+    save_state(args.state, state)
+    return True
+
+
+def save_state(path, state):
+    with open(path, "w") as f:
+        json.dump(state, f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url")
+    parser.add_argument("sha256", help="of the uncompressed image, as pack.py prints it")
+    parser.add_argument("-o", "--output", default="partition.bin", help="stands in for the app partition")
+    parser.add_argument("--state", help="progress file, stands in for NVS (default: <output>.state)")
+    parser.add_argument("--retries", type=int, default=0, help="attempts after an interruption")
+    parser.add_argument("--timeout", type=float, default=15)
+    args = parser.parse_args()
+    args.state = args.state or args.output + ".state"
+
+    sha256 = bytes.fromhex(args.sha256)
+    state = {}
+    if os.path.exists(args.state):
+        with open(args.state) as f:
+            state = json.load(f)
+    for attempt in range(args.retries + 1):
+        try:
+            run_update(args, sha256, state)
+            print(f"{args.output}: verified")
+            return
+        except (OSError, ValueError) as err:
+            print(f"attempt {attempt + 1} failed at block {state.get('next', 0)}: {err}")
+            if attempt < args.retries:
+                time.sleep(1)
+    raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Pack a firmware image (.pio/build/<env>/firmware.bin) into a container for over-the-air updates.
+
+    ./pack.py firmware.bin -o firmware.bota --url http://192.168.1.10:8000/firmware.bota
+
+Prints the size saved and the cloud-to-device command that starts the update. Blocks that do not
+shrink are stored as they are.
+"""
+import argparse
+import hashlib
+import json
+import zlib
+
+import bota
+
+
+def pack(image, block_size, level):
+    blocks = []
+    payloads = []
+    offset = bota.header_size((len(image) + block_size - 1) // block_size)
+    for start in range(0, len(image), block_size):
+        block = image[start:start + block_size]
+        compressor = zlib.compressobj(level, zlib.DEFLATED, -zlib.MAX_WBITS, 9)
+        payload = compressor.compress(block) + compressor.flush()
+        method = bota.DEFLATE
+        if len(payload) >= len(block):
+            payload, method = block, bota.STORED
+        blocks.append((offset, len(payload), zlib.crc32(block), method))
+        payloads.append(payload)
+        offset += len(payload)
+
+    header = bota.HEADER.pack(bota.MAGIC, bota.VERSION, bota.header_size(len(blocks)), block_size, len(blocks),
+                              len(image), hashlib.sha256(image).digest())
+    return header + b"".join(bota.BLOCK.pack(*block) for block in blocks) + b"".join(payloads)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image")
+    parser.add_argument("-o", "--output", help="default: the image name with .bota")
+    parser.add_argument("--block-size", type=int, default=bota.MAX_BLOCK,
+                        help="uncompressed bytes per block, a multiple of 4096 up to 32768 (default %(default)s)")
+    parser.add_argument("--level", type=int, default=9, help="deflate level (default %(default)s)")
+    parser.add_argument("--url", help="where the container will be served, for the printed command")
+    args = parser.parse_args()
+
+    if args.block_size <= 0 or args.block_size > bota.MAX_BLOCK or args.block_size % bota.SECTOR_SIZE:
+        parser.error("--block-size must be a multiple of 4096 up to 32768")
+    with open(args.image, "rb") as f:
+        image = f.read()
+    block_count = (len(image) + args.block_size - 1) // args.block_size
+    if bota.header_size(block_count) > bota.MAX_HEADER:
+        parser.error("image too large for the block table, use larger blocks")
+
+    container = pack(image, args.block_size, args.level)
+    output = args.output or args.image.rsplit(".", 1)[0] + ".bota"
+    with open(output, "wb") as f:
+        f.write(container)
+
+    print(f"{output}: {len(image)} -> {len(container)} bytes ({100 * len(container) / len(image):.1f}%), "
+          f"{block_count} blocks of {args.block_size}")
+    command = {"otaUrl": args.url or f"http://<host>:8000/{output.rsplit('/', 1)[-1]}",
+               "otaSha256": hashlib.sha256(image).hexdigest()}
+    print(json.dumps(command))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Local stand-in for the update server: serves a directory over HTTP with range requests.
+
+    ./serve.py --dir . --port 8000
+    ./serve.py --drop-after 200000 --drops 2 --rate 50
+
+--drop-after closes the connection after that many body bytes, for the first --drops responses, to
+test resuming; --rate limits each response to that many KB/s, like a slow link.
+"""
+import argparse
+import functools
+import http.server
+import os
+import re
+import time
+
+CHUNK = 4096
+
+
+class RangeHandler(http.server.SimpleHTTPRequestHandler):
+    def do_GET(self):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+        status = 200
+        match = re.fullmatch(r"bytes=(\d*)-(\d*)", self.headers.get("Range", ""))
+        if match and match.group(1) + match.group(2):
+            if match.group(1):
+                start = int(match.group(1))
+                end = min(int(match.group(2)), size - 1) if match.group(2) else size - 1
+            else:
+                start = max(0, size - int(match.group(2)))
+            if start >= size or start > end:
+                self.send_response(416)
+                self.send_header("Content-Range", f"bytes */{size}")
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            status = 206
+
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("Content-Length", str(end - start + 1))
+        if status == 206:
+            self.send_header("Content-Range", f"bytes {start}-{end}/{size}")
+        self.end_headers()
+
+        limit = end - start + 1
+        if self.server.drops > 0 and limit > self.server.drop_after:
+            self.server.drops -= 1
+            limit = self.server.drop_after
+            self.log_message("dropping the connection after %d bytes", limit)
+        try:
+            with open(path, "rb") as f:
+                f.seek(start)
+                while limit > 0:
+                    data = f.read(min(CHUNK, limit))
+                    self.wfile.write(data)
+                    limit -= len(data)
+                    if self.server.rate:
+                        time.sleep(len(data) / (self.server.rate * 1024))
+        except ConnectionError:
+            self.log_message("client closed the connection")
+        self.close_connection = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--dir", default=".")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--drop-after", type=int, default=0, help="body bytes sent before dropping a connection")
+    parser.add_argument("--drops", type=int, default=1, help="connections to drop (default %(default)s)")
+    parser.add_argument("--rate", type=float, default=0, help="KB/s per response (default: unlimited)")
+    args = parser.parse_args()
+
+    server = http.server.ThreadingHTTPServer(("", args.port), functools.partial(RangeHandler, directory=args.dir))
+    server.drop_after = args.drop_after
+    server.drops = args.drops if args.drop_after > 0 else 0
+    server.rate = args.rate
+    print(f"Serving {os.path.abspath(args.dir)} on port {args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Synthesize an input trace (the format src/trace.h records) for benchmarking the replayer.
+
+    ./gentrace.py --hours 24 --seed 1 > day.txt
+
+Light follows a day/night cycle with sensor noise, temperature and humidity drift slowly, and every
+few minutes someone browses the menu, changes a setting or dismisses a reminder.
+"""
+import argparse
+import math
+import random
+
+LEFT, RIGHT, UP, DOWN = 32, 2, 17, 15
+
+LIGHT_INTERVAL = 100
+TEMP_HUM_INTERVAL = 1000
+
+
+def press(events, time, pin, hold):
+    events.append((time, f"B {pin} 0"))
+    events.append((time + hold, f"B {pin} 1"))
+    return time + hold
+
+
+def session(events, time, rng):
+    """One interaction: a few taps, sometimes a long press, with human gaps between them."""
+    kind = rng.choice(["browse", "setting", "dismiss", "do_not_disturb"])
+    steps = {
+        "browse": [RIGHT] + [DOWN] * rng.randint(0, 5) + [RIGHT, LEFT, LEFT],
+        "setting": [RIGHT, DOWN, DOWN, DOWN, RIGHT] + [UP] * rng.randint(1, 4) + [LEFT, LEFT],
+        "dismiss": [UP],
+        "do_not_disturb": [UP],
+    }[kind]
+    for i, pin in enumerate(steps):
+        long_press = kind == "do_not_disturb" or (kind == "browse" and i == len(steps) - 1 and rng.random() < 0.3)
+        hold = rng.randint(400, 900) if long_press else rng.randint(60, 180)
+        time = press(events, time, pin, hold) + rng.randint(300, 1500)
+    return time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--hours", type=float, default=24)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--sessions-per-hour", type=float, default=6)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    duration = int(args.hours * 3600 * 1000)
+    events = []
+
+    # Initial pin levels, as the recorder prints them on its first loop
+    for pin in (LEFT, RIGHT, UP, DOWN):
+        events.append((1000, f"B {pin} 1"))
+
+    temperature, humidity = 22.0, 45.0
+    for time in range(1000, duration, LIGHT_INTERVAL):
+        day = math.sin(2 * math.pi * time / (24 * 3600 * 1000))
+        light = 2048 + 1500 * day + rng.gauss(0, 40)
+        events.append((time, f"A {int(min(4095, max(0, light)))}"))
+        if time % TEMP_HUM_INTERVAL == 0:
+            temperature += rng.gauss(0, 0.02) + 0.0005 * (22 + 4 * day - temperature)
+            humidity += rng.gauss(0, 0.05) + 0.0005 * (45 - 10 * day - humidity)
+            events.append((time + 80, f"D 0 {temperature:.2f} {humidity:.2f}"))
+
+    time = 5000
+    while True:
+        time += int(rng.expovariate(args.sessions_per_hour / 3600000))
+        if time >= duration:
+            break
+        time = session(events, time, rng)
+
+    events.sort(key=lambda event: event[0])
+    for time, event in events:
+        print(f"@{time} {event}")
+
+
+if __name__ == "__main__":
+    main()
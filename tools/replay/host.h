@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+//State shared by the Arduino shims and the replayer: the virtual clock, the inputs the trace drives
+//and the output log (frames, pins, PWM, telemetry) that a replay produces
+namespace host {
+
+//Virtual millis(); it starts at offset_ms and wraps at 2^32 like the ESP32's
+inline uint32_t clock_ms = 0;
+inline uint32_t offset_ms = 0;
+
+//Called whenever the clock moves (also from delay()), so the replayer can apply trace events
+inline void (*on_advance)() = nullptr;
+
+inline void advance(uint32_t ms) {
+  clock_ms += ms;
+  if(on_advance) {
+    on_advance();
+  }
+}
+
+//Time since the trace started, what every log line and trace event is stamped with
+inline uint32_t traceTime() {
+  return clock_ms - offset_ms;
+}
+
+//Inputs
+const int PINS = 64;
+inline int input_levels[PINS]; //digitalRead()
+inline int adc = 0; //analogRead(), the light sensor is the only analog input
+struct TempHum {
+  int status;
+  float temperature;
+  float humidity;
+};
+inline TempHum temp_hum = {0, 0, 0};
+
+//Outputs
+inline FILE* log = stdout; //nullptr: no log
+inline bool echo_serial = false;
+inline int output_levels[PINS];
+inline unsigned int tones[PINS];
+inline int pwm[16];
+
+inline void emit(const char* format, ...) {
+  if(!log) {
+    return;
+  }
+  fprintf(log, "%u ", traceTime());
+  va_list args;
+  va_start(args, format);
+  vfprintf(log, format, args);
+  va_end(args);
+  fputc('\n', log);
+}
+
+//Draw calls since the last loop(); the replayer logs them as one frame
+struct Frame {
+  int ops = 0;
+  std::string text;
+  bool new_segment = true;
+};
+inline Frame frame;
+
+inline void drawOp() {
+  ++frame.ops;
+}
+
+//Text drawn at a new cursor position starts a new '|' separated segment
+inline void drawText(const std::string& text) {
+  ++frame.ops;
+  if(frame.new_segment && !frame.text.empty()) {
+    frame.text += '|';
+  }
+  frame.new_segment = false;
+  frame.text += text;
+}
+
+}
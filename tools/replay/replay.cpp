@@ -0,0 +1,290 @@
+//Replays an input trace (see src/trace.h) through the firmware's setup()/loop() on a virtual clock
+//
+//  replay [-t tick_ms] [-o clock_offset_ms] [-e extra_ms] [-q] [-v] trace.txt
+//
+//  -t  virtual time between loop() calls (default 1 ms)
+//  -o  value of millis() when the trace starts, e.g. 4294900000 to cross the 32-bit rollover
+//  -e  keep running this long after the last event (default 60000 ms)
+//  -q  no output log, only the summary
+//  -v  echo the firmware's Serial output to stderr
+//
+//The output log (stdout) is deterministic, so two builds can be diffed over the same trace:
+//  <ms> frame <draw ops> <text drawn, '|' between cursor moves>
+//  <ms> pin <pin> <level> / tone <pin> <Hz> / pwm <channel> <duty> / send <temp> <hum> <brightness>
+//The summary (stderr) reports host time per loop() and how long each button release and command
+//took to produce a frame.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "dataSend.h"
+
+struct TraceEvent {
+  uint32_t time;
+  char type;
+  int pin;
+  int value;
+  float temperature;
+  float humidity;
+  std::string json;
+};
+
+//An input waiting for the frame it caused
+struct PendingInput {
+  uint32_t time;
+  bool command;
+  double host_us;
+};
+
+std::vector<TraceEvent> events;
+size_t next_event = 0;
+std::deque<std::string> commands;
+std::vector<PendingInput> pending;
+
+//Parse "[@]<ms> <type> <fields>" lines, skipping everything else (a raw Serial capture works)
+bool loadTrace(const char* path) {
+  std::ifstream file(path);
+  if(!file) {
+    return false;
+  }
+
+  std::string line;
+  while(std::getline(file, line)) {
+    if(!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    size_t at = line.find('@');
+    std::istringstream fields(at == std::string::npos ? line : line.substr(at + 1));
+    TraceEvent event = {};
+    if(!(fields >> event.time >> event.type)) {
+      continue;
+    }
+
+    bool ok = false;
+    switch(event.type) {
+      case 'A':
+        ok = static_cast<bool>(fields >> event.value);
+        break;
+      case 'D':
+        ok = static_cast<bool>(fields >> event.value >> event.temperature >> event.humidity);
+        break;
+      case 'B':
+        ok = static_cast<bool>(fields >> event.pin >> event.value) && event.pin >= 0 && event.pin < host::PINS;
+        break;
+      case 'C':
+        std::getline(fields >> std::ws, event.json);
+        ok = !event.json.empty() && event.json.size() < (size_t) COMMAND_SIZE;
+        break;
+    }
+    if(ok) {
+      events.push_back(event);
+    }
+  }
+
+  std::stable_sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+    return a.time < b.time;
+  });
+  return true;
+}
+
+//Apply the trace events that are due at the current virtual time
+void applyEvents() {
+  uint32_t now = host::traceTime();
+  while(next_event < events.size() && events[next_event].time <= now) {
+    const TraceEvent& event = events[next_event++];
+    switch(event.type) {
+      case 'A':
+        host::adc = event.value;
+        break;
+      case 'D':
+        host::temp_hum = {event.value, event.temperature, event.humidity};
+        break;
+      case 'B':
+        //Taps are handled on release
+        if(host::input_levels[event.pin] == LOW && event.value == HIGH) {
+          pending.push_back({event.time, false, 0});
+        }
+        host::input_levels[event.pin] = event.value;
+        break;
+      case 'C':
+        commands.push_back(event.json);
+        pending.push_back({event.time, true, 0});
+        break;
+    }
+  }
+}
+
+//Telemetry and commands: sends are logged, commands come from the trace
+void startWiFi() {
+}
+
+void startTelemetry() {
+}
+
+void sendData(float temperature, float humidity, int brightness, const SensorWindow&) {
+  host::emit("send %.2f %.2f %d", temperature, humidity, brightness);
+}
+
+bool receiveCommand(char* buffer, size_t size) {
+  if(commands.empty()) {
+    return false;
+  }
+  strncpy(buffer, commands.front().c_str(), size - 1);
+  buffer[size - 1] = '\0';
+  commands.pop_front();
+  return true;
+}
+
+//Log the draw calls of the last loop() as one frame, returns false if nothing was drawn
+bool flushFrame() {
+  if(host::frame.ops == 0) {
+    return false;
+  }
+  host::emit("frame %d %s", host::frame.ops, host::frame.text.c_str());
+  host::frame = host::Frame();
+  return true;
+}
+
+//Histogram of loop() host time in 10 ns buckets (the tail above 100 us only counts towards the max)
+struct LoopTimes {
+  static const int BUCKETS = 10000;
+  std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKETS + 1);
+  uint64_t calls = 0;
+  double total_us = 0;
+  double max_us = 0;
+
+  void add(double us) {
+    ++calls;
+    total_us += us;
+    max_us = std::max(max_us, us);
+    buckets[std::min<int>(us * 100, BUCKETS)] += 1;
+  }
+
+  double percentile(double p) const {
+    uint64_t rank = calls * p / 100;
+    uint64_t seen = 0;
+    for(int i = 0; i <= BUCKETS; ++i) {
+      seen += buckets[i];
+      if(seen > rank) {
+        return i / 100.0;
+      }
+    }
+    return max_us;
+  }
+};
+
+double percentile(std::vector<double> values, double p) {
+  if(values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min<size_t>(values.size() * p / 100, values.size() - 1)];
+}
+
+void printResponses(const char* name, const std::vector<double>& virtual_ms, const std::vector<double>& host_us) {
+  if(virtual_ms.empty()) {
+    return;
+  }
+  double total = 0;
+  for(double us : host_us) {
+    total += us;
+  }
+  fprintf(stderr, "# %s: %zu, frame after p50 %.0f ms p99 %.0f ms max %.0f ms, handling avg %.1f us max %.1f us\n",
+    name, virtual_ms.size(), percentile(virtual_ms, 50), percentile(virtual_ms, 99), percentile(virtual_ms, 100),
+    total / host_us.size(), percentile(host_us, 100));
+}
+
+int main(int argc, char** argv) {
+  uint32_t tick_ms = 1;
+  uint32_t extra_ms = 60000;
+  const char* path = nullptr;
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      tick_ms = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+    }
+    else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      host::offset_ms = strtoul(argv[++i], nullptr, 10);
+    }
+    else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      extra_ms = strtoul(argv[++i], nullptr, 10);
+    }
+    else if(strcmp(argv[i], "-q") == 0) {
+      host::log = nullptr;
+    }
+    else if(strcmp(argv[i], "-v") == 0) {
+      host::echo_serial = true;
+    }
+    else {
+      path = argv[i];
+    }
+  }
+  if(!path || !loadTrace(path)) {
+    fprintf(stderr, "usage: replay [-t tick_ms] [-o clock_offset_ms] [-e extra_ms] [-q] [-v] trace.txt\n");
+    return 1;
+  }
+
+  //Buttons idle high (pull-ups)
+  std::fill(std::begin(host::input_levels), std::end(host::input_levels), HIGH);
+  host::clock_ms = host::offset_ms;
+  host::on_advance = applyEvents;
+  uint32_t end = (events.empty() ? 0 : events.back().time) + extra_ms;
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  applyEvents();
+  setup();
+  flushFrame();
+
+  LoopTimes loop_times;
+  uint64_t frames = 0;
+  uint64_t draw_ops = 0;
+  int unanswered = 0;
+  std::vector<double> button_ms, button_us, command_ms, command_us;
+  while(host::traceTime() < end) {
+    host::advance(tick_ms);
+
+    Clock::time_point loop_start = Clock::now();
+    loop();
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - loop_start).count();
+    loop_times.add(us);
+    for(PendingInput& input : pending) {
+      input.host_us += us;
+    }
+
+    int ops = host::frame.ops;
+    if(flushFrame()) {
+      ++frames;
+      draw_ops += ops;
+      for(const PendingInput& input : pending) {
+        (input.command ? command_ms : button_ms).push_back(host::traceTime() - input.time);
+        (input.command ? command_us : button_us).push_back(input.host_us);
+      }
+      pending.clear();
+    }
+    //Inputs that changed nothing on screen (e.g. a command while another screen is shown)
+    while(!pending.empty() && host::traceTime() - pending.front().time > 5000) {
+      pending.erase(pending.begin());
+      ++unanswered;
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  fprintf(stderr, "# replayed %.1f s of trace in %.2f s (%.0fx real time), %zu events\n",
+    end / 1000.0, seconds, end / 1000.0 / seconds, events.size());
+  fprintf(stderr, "# loop(): %llu calls, avg %.2f us p50 %.2f us p99 %.2f us max %.1f us\n",
+    (unsigned long long) loop_times.calls, loop_times.total_us / loop_times.calls,
+    loop_times.percentile(50), loop_times.percentile(99), loop_times.max_us);
+  fprintf(stderr, "# frames: %llu, %.1f draw ops avg\n", (unsigned long long) frames, frames ? (double) draw_ops / frames : 0);
+  printResponses("button releases", button_ms, button_us);
+  printResponses("commands", command_ms, command_us);
+  if(unanswered > 0) {
+    fprintf(stderr, "# inputs without a frame within 5 s: %d\n", unanswered);
+  }
+  if(sizeof(unsigned long) != 4) {
+    fprintf(stderr, "# note: unsigned long is %zu bytes here (4 on the ESP32), millis() rollover is not reproduced\n", sizeof(unsigned long));
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+//Just enough of the Arduino core for the firmware logic to run on the host against the virtual clock
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "host.h"
+
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define PROGMEM
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+template<class T> T min(T a, T b) {
+  return b < a ? b : a;
+}
+
+template<class T> T max(T a, T b) {
+  return a < b ? b : a;
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+inline unsigned long millis() {
+  return host::clock_ms;
+}
+
+inline unsigned long micros() {
+  return host::clock_ms * 1000u;
+}
+
+inline void delay(unsigned long ms) {
+  host::advance(ms);
+}
+
+inline void pinMode(uint8_t, uint8_t) {
+}
+
+inline int digitalRead(uint8_t pin) {
+  return host::input_levels[pin];
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  if(host::output_levels[pin] != level) {
+    host::output_levels[pin] = level;
+    host::emit("pin %d %d", pin, level);
+  }
+}
+
+inline uint16_t analogRead(uint8_t) {
+  return host::adc;
+}
+
+inline void tone(uint8_t pin, unsigned int frequency, unsigned long = 0) {
+  if(host::tones[pin] != frequency) {
+    host::tones[pin] = frequency;
+    host::emit("tone %d %u", pin, frequency);
+  }
+}
+
+inline void noTone(uint8_t pin) {
+  tone(pin, 0);
+}
+
+class String {
+  public:
+    String(const char* text = "") : value(text ? text : "") {}
+    String(const std::string& text) : value(text) {}
+    String(char c) : value(1, c) {}
+    String(int number) : value(std::to_string(number)) {}
+    String(unsigned int number) : value(std::to_string(number)) {}
+    String(long number) : value(std::to_string(number)) {}
+    String(unsigned long number) : value(std::to_string(number)) {}
+    String(float number, unsigned char decimals = 2) : String((double) number, decimals) {}
+    String(double number, unsigned char decimals = 2) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+      value = buffer;
+    }
+
+    const char* c_str() const {
+      return value.c_str();
+    }
+
+    unsigned int length() const {
+      return value.size();
+    }
+
+    String& operator+=(const String& other) {
+      value += other.value;
+      return *this;
+    }
+
+    friend String operator+(const String& a, const String& b) {
+      return String(a.value + b.value);
+    }
+
+    friend bool operator==(const String& a, const String& b) {
+      return a.value == b.value;
+    }
+
+  private:
+    std::string value;
+};
+
+//Serial output only shows with the replayer's -v
+class HardwareSerial {
+  public:
+    void begin(unsigned long) {
+    }
+
+    void print(const String& text) {
+      if(host::echo_serial) {
+        fputs(text.c_str(), stderr);
+      }
+    }
+
+    void println(const String& text) {
+      print(text);
+      print("\n");
+    }
+
+    void printf(const char* format, ...) {
+      if(host::echo_serial) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+      }
+    }
+};
+
+inline HardwareSerial Serial;
+
+void setup();
+
+void loop();
@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+
+//Button2 as the firmware uses it: debounced, the tap handler runs on release
+//and wasPressedFor() is how long that press lasted
+class Button2 {
+  public:
+    typedef void (*CallbackFunction)(Button2&);
+
+    void begin(uint8_t button_pin, uint8_t mode = INPUT_PULLUP, bool active_low = true) {
+      (void) mode;
+      pin = button_pin;
+      activeLow = active_low;
+      pressed = isDown();
+      last_change = millis();
+    }
+
+    void setTapHandler(CallbackFunction handler) {
+      tap_handler = handler;
+    }
+
+    uint8_t getPin() const {
+      return pin;
+    }
+
+    unsigned int wasPressedFor() const {
+      return pressed_for;
+    }
+
+    void loop() {
+      bool down = isDown();
+      if(down == pressed || millis() - last_change < DEBOUNCE_MS) {
+        return;
+      }
+      pressed = down;
+      last_change = millis();
+      if(pressed) {
+        down_time = millis();
+      }
+      else {
+        pressed_for = millis() - down_time;
+        if(tap_handler) {
+          tap_handler(*this);
+        }
+      }
+    }
+
+  private:
+    static const unsigned long DEBOUNCE_MS = 50; //Button2's default
+
+    uint8_t pin = 0;
+    bool activeLow = true;
+    bool pressed = false;
+    unsigned long last_change = 0;
+    unsigned long down_time = 0;
+    unsigned int pressed_for = 0;
+    CallbackFunction tap_handler = nullptr;
+
+    bool isDown() const {
+      return (digitalRead(pin) == LOW) == activeLow;
+    }
+};
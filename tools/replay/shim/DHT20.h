@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+#define DHT20_OK 0
+
+//Measurements come from the trace: a conversion returns the latest recorded one
+class DHT20 {
+  public:
+    DHT20(TwoWire* = &Wire) {}
+
+    bool begin() {
+      return true;
+    }
+
+    int read() {
+      readData();
+      return convert();
+    }
+
+    int requestData() {
+      request_time = millis();
+      return DHT20_OK;
+    }
+
+    bool isMeasuring() {
+      return millis() - request_time < MEASURE_MS;
+    }
+
+    int readData() {
+      return 7; //Bytes read
+    }
+
+    int convert() {
+      temperature = host::temp_hum.temperature;
+      humidity = host::temp_hum.humidity;
+      return host::temp_hum.status;
+    }
+
+    float getTemperature() {
+      return temperature;
+    }
+
+    float getHumidity() {
+      return humidity;
+    }
+
+  private:
+    static const unsigned long MEASURE_MS = 80;
+
+    unsigned long request_time = 0;
+    float temperature = 0;
+    float humidity = 0;
+};
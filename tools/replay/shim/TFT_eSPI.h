@@ -0,0 +1,125 @@
+#pragma once
+#include <Arduino.h>
+
+//Drawing is not rendered: every call counts as a draw op of the current frame and text is kept,
+//so a replay logs which screens were drawn and with what
+
+#define TFT_BLACK 0x0000
+#define TFT_BLUE 0x001F
+#define TFT_RED 0xF800
+#define TFT_WHITE 0xFFFF
+#define TFT_DARKGREY 0x7BEF
+
+#define TFT_SLPIN 0x10
+#define TFT_SLPOUT 0x11
+#define TFT_DISPOFF 0x28
+#define TFT_DISPON 0x29
+
+class TFT_eSPI {
+  public:
+    void init() {
+      host::drawOp();
+    }
+
+    void setRotation(uint8_t) {
+    }
+
+    int16_t width() const {
+      return 240; //Rotation 3
+    }
+
+    int16_t textWidth(const String& text) {
+      return text.length() * 6 * text_size;
+    }
+
+    void setTextSize(uint8_t size) {
+      text_size = size;
+    }
+
+    void setTextColor(uint16_t, uint16_t) {
+    }
+
+    void setCursor(int16_t, int16_t) {
+      host::frame.new_segment = true;
+    }
+
+    void print(const String& text) {
+      host::drawText(text.c_str());
+    }
+
+    void writecommand(uint8_t command) {
+      switch(command) {
+        case TFT_SLPIN:
+          host::drawText("[sleep in]");
+          break;
+        case TFT_SLPOUT:
+          host::drawText("[sleep out]");
+          break;
+        case TFT_DISPOFF:
+          host::drawText("[display off]");
+          break;
+        case TFT_DISPON:
+          host::drawText("[display on]");
+          break;
+      }
+    }
+
+    void fillScreen(uint16_t) {
+      host::drawOp();
+    }
+
+    void fillRect(int32_t, int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void drawRect(int32_t, int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void fillRoundRect(int32_t, int32_t, int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void drawRoundRect(int32_t, int32_t, int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void fillCircle(int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void drawCircle(int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void drawFastHLine(int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+    void drawFastVLine(int32_t, int32_t, int32_t, uint32_t) {
+      host::drawOp();
+    }
+
+  private:
+    uint8_t text_size = 1;
+};
+
+class TFT_eSprite {
+  public:
+    TFT_eSprite(TFT_eSPI*) {}
+
+    void* createSprite(int16_t, int16_t) {
+      return this;
+    }
+
+    void setSwapBytes(bool) {
+    }
+
+    void pushImage(int32_t, int32_t, int32_t, int32_t, const uint16_t*) {
+      host::drawOp();
+    }
+
+    void pushSprite(int32_t, int32_t, uint16_t) {
+      host::drawOp();
+    }
+};
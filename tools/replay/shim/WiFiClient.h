@@ -0,0 +1,2 @@
+#pragma once
+//Not needed on the host: telemetry is logged by the replayer (see replay.cpp)
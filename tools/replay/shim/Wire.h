@@ -0,0 +1,9 @@
+#pragma once
+
+class TwoWire {
+  public:
+    void begin() {
+    }
+};
+
+inline TwoWire Wire;
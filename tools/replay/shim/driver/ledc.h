@@ -0,0 +1,62 @@
+#pragma once
+#include "host.h"
+
+//LEDC types the firmware configures; duty changes are logged as "pwm <channel> <duty>"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum { LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3, LEDC_CHANNEL_4, LEDC_CHANNEL_5, LEDC_CHANNEL_6, LEDC_CHANNEL_7 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum { LEDC_TIMER_8_BIT = 8 } ledc_timer_bit_t;
+typedef enum { LEDC_AUTO_CLK } ledc_clk_cfg_t;
+typedef enum { LEDC_INTR_DISABLE } ledc_intr_type_t;
+typedef enum { LEDC_FADE_NO_WAIT } ledc_fade_mode_t;
+
+typedef struct {
+  ledc_mode_t speed_mode;
+  ledc_timer_bit_t duty_resolution;
+  ledc_timer_t timer_num;
+  uint32_t freq_hz;
+  ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct {
+  int gpio_num;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  ledc_intr_type_t intr_type;
+  ledc_timer_t timer_sel;
+  uint32_t duty;
+  int hpoint;
+} ledc_channel_config_t;
+
+inline esp_err_t ledc_timer_config(const ledc_timer_config_t*) {
+  return ESP_OK;
+}
+
+inline esp_err_t ledc_channel_config(const ledc_channel_config_t*) {
+  return ESP_OK;
+}
+
+inline esp_err_t ledc_fade_func_install(int) {
+  return ESP_OK;
+}
+
+//Fades are logged with their target duty
+inline esp_err_t ledc_set_duty_and_update(ledc_mode_t, ledc_channel_t channel, uint32_t duty, uint32_t) {
+  if(host::pwm[channel] != (int) duty) {
+    host::pwm[channel] = duty;
+    host::emit("pwm %d %u", channel, duty);
+  }
+  return ESP_OK;
+}
+
+inline esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty, int) {
+  return ledc_set_duty_and_update(mode, channel, duty, 0);
+}
+
+inline esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t, ledc_fade_mode_t) {
+  return ESP_OK;
+}
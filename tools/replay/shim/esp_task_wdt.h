@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+//The replayer has no watchdog (a stalled loop() just hangs the replay)
+inline int esp_task_wdt_init(uint32_t, bool) {
+  return 0;
+}
+
+inline int esp_task_wdt_add(void*) {
+  return 0;
+}
+
+inline int esp_task_wdt_reset() {
+  return 0;
+}
@@ -2,78 +2,41 @@
 /* eslint-disable no-restricted-globals */
 /* eslint-disable no-undef */
 
-//Convert value to percentage
+//Convert value to percentage, returns false if the chart already shows it
 function toPercentage(chart, value, maxValue) {
   //Ensure no out-of-bounds
   const rounded = Math.round(Math.min(value, maxValue));
+  if (chart.data.datasets[0].data[0] === rounded) {
+    return false;
+  }
   chart.data.datasets[0].data = [rounded, maxValue - rounded];
   chart.options.title.text = rounded + chart.unit;
+  return true;
 }
 
-//Convert Date to formatted string
-function formateDate(date) {
-  const year = date.getFullYear();
-  const month = String(date.getMonth() + 1).padStart(2, '0');
-  const day = String(date.getDate()).padStart(2, '0');
-  const hours = String(date.getHours()).padStart(2, '0');
-  const minutes = String(date.getMinutes()).padStart(2, '0');
-  return `${year}-${month}-${day} ${hours}:${minutes}`;
+//Write point n of a decimated series, reusing the point objects Chart.js already has
+function setPoint(out, n, x, y) {
+  if (out[n]) {
+    out[n].x = x;
+    out[n].y = y;
+  } else {
+    out[n] = { x, y };
+  }
 }
 
 $(document).ready(() => {
   // if deployed to a site supporting SSL, use wss://
   const protocol = document.location.protocol.startsWith('https') ? 'wss://' : 'ws://';
-  const webSocket = new WebSocket(protocol + location.host);
-
-  // A class for holding the last N points of telemetry for a device
-  class DeviceData {
-    constructor(deviceId) {
-      this.deviceId = deviceId;
-      this.maxLen = 50;
-      this.timeData = new Array(this.maxLen);
-      this.temperatureData = new Array(this.maxLen);
-      this.humidityData = new Array(this.maxLen);
-      this.brightnessData = new Array(this.maxLen);
-    }
-
-    addData(time, temperature, humidity, brightness) {
-      this.timeData.push(time);
-      this.temperatureData.push(temperature);
-      this.humidityData.push(humidity || null);
-      this.brightnessData.push(brightness || null);
-
-      if (this.timeData.length > this.maxLen) {
-        this.timeData.shift();
-        this.temperatureData.shift();
-        this.humidityData.shift();
-        this.brightnessData.shift();
-      }
-    }
-  }
-
-  // All the devices in the list (those that have been sending telemetry)
-  class TrackedDevices {
-    constructor() {
-      this.devices = [];
-    }
-
-    // Find a device based on its Id
-    findDevice(deviceId) {
-      for (let i = 0; i < this.devices.length; ++i) {
-        if (this.devices[i].deviceId === deviceId) {
-          return this.devices[i];
-        }
-      }
-
-      return undefined;
-    }
+  // ?device=<address> connects straight to an Analog Buddy on the LAN (firmware built with -DLAN_STREAM)
+  // instead of the server; it speaks the same JSON messages, for its one device and without history
+  const lanDevice = new URLSearchParams(location.search).get('device');
+  // Offer the binary telemetry protocol; a server that does not pick it keeps sending JSON
+  const binaryProtocol = 'buddy.telemetry.v1';
 
-    getDevicesCount() {
-      return this.devices.length;
-    }
-  }
-
-  const trackedDevices = new TrackedDevices();
+  // The socket, decoding and device buffers live in a worker (js/telemetry-worker.js, protocol described there);
+  // this thread only draws its snapshots and runs the device picker and alert list.
+  // The page links the worker script, so the asset build rewrites its hashed name
+  const telemetryWorker = new Worker(document.getElementById('telemetryWorker').href);
 
   // Define the chart axes
   const chartData = {
@@ -82,6 +45,7 @@ $(document).ready(() => {
         fill: false,
         label: 'Temperature',
         yAxisID: 'Temperature',
+        data: [],
         borderColor: 'rgba(178, 34, 34, 1)',
         pointBorderColor: 'rgba(205, 92, 92, 1)',
         backgroundColor: 'rgba(178, 34, 34, 0.4)',
@@ -93,6 +57,7 @@ $(document).ready(() => {
         fill: false,
         label: 'Humidity',
         yAxisID: 'Humidity',
+        data: [],
         borderColor: 'rgba(0, 128, 128, 1)',
         pointBorderColor: 'rgba(72, 209, 204, 1)',
         backgroundColor: 'rgba(0, 128, 128, 0.4)',
@@ -104,6 +69,7 @@ $(document).ready(() => {
         fill: false,
         label: 'Brightness',
         yAxisID: 'Brightness',
+        data: [],
         borderColor: 'rgba(255, 165, 79, 1)',
         pointBorderColor: 'rgba(255, 200, 124, 1)',
         backgroundColor: 'rgba(255, 165, 79, 0.4)',
@@ -115,7 +81,33 @@ $(document).ready(() => {
   };
 
   const chartOptions = {
+    // Redrawn at most once per frame; animating every update would only queue more work
+    animation: {
+      duration: 0,
+    },
+    // Thousands of points per line: draw no markers, but keep them hoverable
+    elements: {
+      point: {
+        radius: 0,
+        hitRadius: 4,
+      },
+    },
     scales: {
+      xAxes: [{
+        type: 'time',
+        time: {
+          tooltipFormat: 'YYYY-MM-DD HH:mm:ss',
+          displayFormats: {
+            minute: 'HH:mm',
+            hour: 'HH:mm',
+          },
+        },
+        ticks: {
+          fontColor: 'rgba(43, 47, 40, 1)',
+          maxRotation: 0,
+          autoSkip: true,
+        },
+      }],
       yAxes: [{
         id: 'Temperature',
         type: 'linear',
@@ -310,94 +302,222 @@ $(document).ready(() => {
   );
   myBrightDoughnutChart.unit = "";
 
-  // Manage a list of devices in the UI, and update which device data the chart is showing
-  // based on selection
-  let needsAutoSelect = true;
-  const deviceCount = document.getElementById('deviceCount');
-  const listOfDevices = document.getElementById('listOfDevices');
-  function OnSelectionChange() {
-    const device = trackedDevices.findDevice(listOfDevices[listOfDevices.selectedIndex].text);
-    chartData.labels = device.timeData;
-    chartData.datasets[0].data = device.temperatureData;
-    chartData.datasets[1].data = device.humidityData;
-    chartData.datasets[2].data = device.brightnessData;
-
+  // Show the latest values of a device on the doughnut charts (only the ones that changed animate)
+  function updateDoughnuts(latest) {
     //Temperature
-    toPercentage(myTempDoughnutChart, device.temperatureData[device.temperatureData.length - 1], 40);
-    myTempDoughnutChart.update();
+    if (toPercentage(myTempDoughnutChart, latest.temperature, 40)) {
+      myTempDoughnutChart.update();
+    }
 
     //Humidity
-    toPercentage(myHumDoughnutChart, device.humidityData[device.humidityData.length - 1], 100);
-    myHumDoughnutChart.update();
+    if (toPercentage(myHumDoughnutChart, latest.humidity, 100)) {
+      myHumDoughnutChart.update();
+    }
 
     //Brightness
-    toPercentage(myBrightDoughnutChart, device.brightnessData[device.brightnessData.length - 1], 4095);
-    myBrightDoughnutChart.update();
-    
-    myLineChart.update();
+    if (toPercentage(myBrightDoughnutChart, latest.brightness, 4095)) {
+      myBrightDoughnutChart.update();
+    }
+  }
+
+  // One point per pixel column is all the line can show
+  function chartPoints() {
+    const { chartArea } = myLineChart;
+    const width = chartArea ? chartArea.right - chartArea.left : myLineChart.width;
+    return Math.max(3, Math.round(width));
+  }
+
+  // Draw the worker's latest snapshot on the next animation frame, then hand its arrays back.
+  // The worker sends no other snapshot until then, so there is at most one per frame.
+  let selectedDeviceId;
+  let points = chartPoints();
+  let snapshot;
+  function render() {
+    const { series } = snapshot;
+    if (snapshot.deviceId === selectedDeviceId) {
+      series.forEach((line, i) => {
+        const { data } = chartData.datasets[i];
+        for (let n = 0; n < line.length; ++n) {
+          setPoint(data, n, line.x[n], line.y[n]);
+        }
+        data.length = line.length;
+      });
+      updateDoughnuts(snapshot.latest);
+      myLineChart.update();
+    }
+    snapshot = undefined;
+    telemetryWorker.postMessage({ type: 'rendered', series }, series.flatMap((line) => [line.x.buffer, line.y.buffer]));
+
+    const width = chartPoints();
+    if (width !== points) {
+      points = width;
+      telemetryWorker.postMessage({ type: 'points', points });
+    }
   }
-  listOfDevices.addEventListener('change', OnSelectionChange, false);
 
-  // When a web socket message arrives:
-  // 1. Unpack it
-  // 2. Validate it has date/time and temperature
-  // 3. Find or create a cached device to hold the telemetry data
-  // 4. Append the telemetry data
-  // 5. Update the chart UI
-  webSocket.onmessage = function onMessage(message) {
-    try {
-      const messageData = JSON.parse(message.data);
-      console.log(messageData);
+  // Searchable, virtualized device picker: only the rows in view exist in the DOM,
+  // so the list stays cheap with thousands of devices
+  class DevicePicker {
+    constructor(search, list, onSelect) {
+      this.search = search;
+      this.list = list;
+      this.onSelect = onSelect;
+      this.rowHeight = 24;
+      this.filter = '';
+      this.filtered = [];
+      this.selectedId = undefined;
+      this.renderRequested = false;
 
-      // time and either temperature or humidity are required
-      if (!messageData.MessageDate || (!messageData.IotData.temperature && !messageData.IotData.humidity && !messageData.IotData.brightness)) {
-        return;
+      this.spacer = document.createElement('div');
+      this.spacer.className = 'device_list_spacer';
+      this.list.appendChild(this.spacer);
+      this.rows = [];
+      const visibleRows = Math.ceil(this.list.clientHeight / this.rowHeight) + 1;
+      for (let i = 0; i < visibleRows; ++i) {
+        const row = document.createElement('div');
+        row.className = 'device_list_row';
+        row.addEventListener('click', () => this.onSelect(row.deviceId), false);
+        this.list.appendChild(row);
+        this.rows.push(row);
       }
 
-      // find or add device to list of tracked devices
-      const existingDeviceData = trackedDevices.findDevice(messageData.DeviceId);
-      const formatted_date = formateDate(new Date(messageData.MessageDate));
+      this.list.addEventListener('scroll', () => this.scheduleRender(), { passive: true });
+      this.search.addEventListener('input', () => this.setFilter(this.search.value), false);
+    }
+
+    matches(deviceId) {
+      return this.filter === '' || deviceId.toLowerCase().includes(this.filter);
+    }
+
+    setFilter(text) {
+      this.filter = text.trim().toLowerCase();
+      this.filtered = deviceIds.filter((deviceId) => this.matches(deviceId));
+      this.list.scrollTop = 0;
+      this.scheduleRender();
+    }
+
+    add(deviceId) {
+      if (this.matches(deviceId)) {
+        this.filtered.push(deviceId);
+        this.scheduleRender();
+      }
+    }
 
-      if (existingDeviceData) {
-        //existingDeviceData.addData(messageData.MessageDate, messageData.IotData.temperature, messageData.IotData.humidity, messageData.IotData.brightness);
-        existingDeviceData.addData(formatted_date, messageData.IotData.temperature, messageData.IotData.humidity, messageData.IotData.brightness);
-      } else {
-        const newDeviceData = new DeviceData(messageData.DeviceId);
-        trackedDevices.devices.push(newDeviceData);
-        const numDevices = trackedDevices.getDevicesCount();
-        deviceCount.innerText = numDevices === 1 ? `${numDevices} device` : `${numDevices} devices`;
-        //newDeviceData.addData(messageData.MessageDate, messageData.IotData.temperature, messageData.IotData.humidity, messageData.IotData.brightness);
-        newDeviceData.addData(formatted_date, messageData.IotData.temperature, messageData.IotData.humidity, messageData.IotData.brightness);
+    select(deviceId) {
+      this.selectedId = deviceId;
+      this.scheduleRender();
+    }
 
-        // add device to the UI list
-        const node = document.createElement('option');
-        const nodeText = document.createTextNode(messageData.DeviceId);
-        node.appendChild(nodeText);
-        listOfDevices.appendChild(node);
+    scheduleRender() {
+      if (!this.renderRequested) {
+        this.renderRequested = true;
+        requestAnimationFrame(() => this.render());
+      }
+    }
 
-        // if this is the first device being discovered, auto-select it
-        if (needsAutoSelect) {
-          needsAutoSelect = false;
-          listOfDevices.selectedIndex = 0;
-          OnSelectionChange();
+    render() {
+      this.renderRequested = false;
+      this.spacer.style.height = `${this.filtered.length * this.rowHeight}px`;
+      const first = Math.floor(this.list.scrollTop / this.rowHeight);
+      this.rows.forEach((row, i) => {
+        const deviceId = this.filtered[first + i];
+        if (deviceId === undefined) {
+          row.style.display = 'none';
+          return;
+        }
+        row.style.display = '';
+        row.style.transform = `translateY(${(first + i) * this.rowHeight}px)`;
+        if (row.deviceId !== deviceId) {
+          row.deviceId = deviceId;
+          row.textContent = deviceId;
         }
+        row.classList.toggle('selected', deviceId === this.selectedId);
+      });
+    }
+  }
+
+  // Manage a list of devices in the UI, and tell the worker which device the chart is showing.
+  // Only the selected device is subscribed to, so the server sends nothing else.
+  let needsAutoSelect = true;
+  const deviceIds = [];
+  const knownDeviceIds = new Set();
+  const deviceCount = document.getElementById('deviceCount');
+  const devicePicker = new DevicePicker(document.getElementById('deviceSearch'), document.getElementById('deviceList'), selectDevice);
+  function selectDevice(deviceId) {
+    if (!knownDeviceIds.has(deviceId)) {
+      return;
+    }
+    selectedDeviceId = deviceId;
+    telemetryWorker.postMessage({ type: 'select', deviceId });
+    devicePicker.select(deviceId);
+  }
+
+  // Add devices the worker discovered to the UI list; if they are the first ones, auto-select the first
+  function onDevices(newDeviceIds) {
+    newDeviceIds.forEach((deviceId) => {
+      if (!knownDeviceIds.has(deviceId)) {
+        knownDeviceIds.add(deviceId);
+        deviceIds.push(deviceId);
+        devicePicker.add(deviceId);
       }
-      
-      //Temperature
-      toPercentage(myTempDoughnutChart, messageData.IotData.temperature, 40);
-      myTempDoughnutChart.update();
+    });
+    const numDevices = deviceIds.length;
+    deviceCount.innerText = numDevices === 1 ? `${numDevices} device` : `${numDevices} devices`;
 
-      //Humidity
-      toPercentage(myHumDoughnutChart, messageData.IotData.humidity, 100);
-      myHumDoughnutChart.update();
+    if (needsAutoSelect && numDevices > 0) {
+      needsAutoSelect = false;
+      selectDevice(deviceIds[0]);
+    }
+  }
 
-      //Brightness
-      toPercentage(myBrightDoughnutChart, messageData.IotData.brightness, 4095);
-      myBrightDoughnutChart.update();
+  // Alerts raised by the server's analytics (on any device), newest first; a click selects the device
+  const alertList = document.getElementById('alerts');
+  const activeAlerts = new Map();
+  const alertNames = { heatIndex: 'heat index', temperature: 'temperature', humidity: 'humidity', brightness: 'brightness' };
+  function describeAlert(alert) {
+    const metric = alertNames[alert.Metric] || alert.Metric;
+    if (alert.Condition === 'rateAbove') {
+      return `${alert.DeviceId}: ${metric} changing ${alert.Value}/min (limit ${alert.Threshold}/min)`;
+    }
+    return `${alert.DeviceId}: ${metric} ${alert.Value} ${alert.Condition} ${alert.Threshold}`;
+  }
+  function renderAlerts() {
+    alertList.replaceChildren(...Array.from(activeAlerts.values()).reverse().map((alert) => {
+      const item = document.createElement('li');
+      item.textContent = describeAlert(alert);
+      item.addEventListener('click', () => selectDevice(alert.DeviceId));
+      return item;
+    }));
+  }
+  function onAlert(alert) {
+    const key = `${alert.DeviceId}/${alert.Rule}`;
+    activeAlerts.delete(key);
+    if (alert.State === 'raised') {
+      activeAlerts.set(key, alert);
+    }
+  }
 
-      myLineChart.update();
-    } catch (err) {
-      console.error(err);
+  telemetryWorker.onmessage = function onWorkerMessage(event) {
+    const message = event.data;
+    if (message.type === 'snapshot') {
+      snapshot = message;
+      requestAnimationFrame(render);
+    } else if (message.type === 'devices') {
+      onDevices(message.deviceIds);
+    } else if (message.type === 'alerts') {
+      if (message.reset) {
+        activeAlerts.clear();
+      }
+      message.alerts.forEach(onAlert);
+      renderAlerts();
     }
   };
-});
\ No newline at end of file
+
+  telemetryWorker.postMessage({
+    type: 'connect',
+    url: lanDevice ? `ws://${lanDevice}/ws` : protocol + location.host,
+    protocols: lanDevice ? [] : [binaryProtocol],
+    lanDevice,
+    points,
+  });
+});
@@ -0,0 +1,511 @@
+/* eslint-disable max-classes-per-file */
+/* eslint-disable no-restricted-globals */
+
+// The dashboard's data path, off the page's main thread: the WebSocket, decoding JSON and binary frames,
+// the per-device ring buffers, history backfill and decimation. Bursts of messages then cost the page
+// nothing; it only gets render-ready snapshots of the selected device, at most one per frame it draws.
+//
+// Page → worker:
+//   {type: 'connect', url, protocols, lanDevice, points}
+//   {type: 'select', deviceId}
+//   {type: 'points', points}             points per line the chart can show (its width in pixels)
+//   {type: 'rendered', series}           a snapshot was drawn; its typed arrays come back for reuse
+// Worker → page:
+//   {type: 'devices', deviceIds}         devices not announced to the page before
+//   {type: 'alerts', alerts, reset}      alert updates (reset: the list replaces the current one)
+//   {type: 'snapshot', deviceId, latest, series}
+//     series: temperature, humidity and brightness as {x: Float64Array, y: Float32Array, length},
+//     transferred rather than copied; latest: the newest value of each
+
+const FRAME_MS = 1000 / 60;
+
+//Largest-Triangle-Three-Buckets: reduce `length` ring buffer samples (from `start`) to at most
+//`threshold` points that keep the shape of the line. NaN values are skipped.
+//Returns the number of points written to outX/outY.
+function lttb(times, values, start, length, threshold, outX, outY) {
+  const capacity = times.length;
+  const at = (i) => (start + i) % capacity;
+
+  if (length <= threshold || threshold < 3) {
+    let n = 0;
+    for (let i = 0; i < length && n < outX.length; ++i) {
+      const value = values[at(i)];
+      if (!Number.isNaN(value)) {
+        outX[n] = times[at(i)];
+        outY[n++] = value;
+      }
+    }
+    return n;
+  }
+
+  //First and last points are always kept; the rest are split into threshold - 2 buckets
+  let first = 0;
+  while (first < length && Number.isNaN(values[at(first)])) {
+    first += 1;
+  }
+  if (first === length) {
+    return 0;
+  }
+  let n = 0;
+  let aX = times[at(first)];
+  let aY = values[at(first)];
+  outX[n] = aX;
+  outY[n++] = aY;
+
+  const bucketSize = (length - 2) / (threshold - 2);
+  for (let bucket = 0; bucket < threshold - 2; ++bucket) {
+    const rangeStart = Math.max(Math.floor(bucket * bucketSize) + 1, first + 1);
+    const rangeEnd = Math.floor((bucket + 1) * bucketSize) + 1;
+
+    //Third corner of the triangle: average of the next bucket
+    const nextEnd = Math.min(Math.floor((bucket + 2) * bucketSize) + 1, length);
+    let avgX = 0;
+    let avgY = 0;
+    let count = 0;
+    for (let i = rangeEnd; i < nextEnd; ++i) {
+      const value = values[at(i)];
+      if (!Number.isNaN(value)) {
+        avgX += times[at(i)];
+        avgY += value;
+        count += 1;
+      }
+    }
+    if (count > 0) {
+      avgX /= count;
+      avgY /= count;
+    } else {
+      avgX = times[at(Math.min(rangeEnd, length - 1))];
+      avgY = aY;
+    }
+
+    //Keep the point of this bucket with the largest triangle
+    let maxArea = -1;
+    let chosen = -1;
+    for (let i = rangeStart; i < rangeEnd; ++i) {
+      const value = values[at(i)];
+      if (!Number.isNaN(value)) {
+        const area = Math.abs((aX - avgX) * (value - aY) - (aX - times[at(i)]) * (avgY - aY));
+        if (area > maxArea) {
+          maxArea = area;
+          chosen = i;
+        }
+      }
+    }
+    if (chosen >= 0) {
+      aX = times[at(chosen)];
+      aY = values[at(chosen)];
+      outX[n] = aX;
+      outY[n++] = aY;
+    }
+  }
+
+  const last = values[at(length - 1)];
+  if (!Number.isNaN(last) && length - 1 > first) {
+    outX[n] = times[at(length - 1)];
+    outY[n++] = last;
+  }
+  return n;
+}
+
+// A class for holding the last N points of telemetry for a device (a day of 5 second samples),
+// in typed ring buffers (missing values are NaN) allocated once the device has data
+class DeviceData {
+  constructor(deviceId) {
+    this.deviceId = deviceId;
+    this.maxLen = 24 * 60 * 12;
+    this.timeData = null;
+    this.temperatureData = null;
+    this.humidityData = null;
+    this.brightnessData = null;
+    this.clear();
+  }
+
+  clear() {
+    this.start = 0;
+    this.length = 0;
+    this.lastTime = 0;
+  }
+
+  hasBuffers() {
+    return this.timeData !== null;
+  }
+
+  // Free the buffers of a device nobody looks at (its history is re-sent when it is subscribed again)
+  release() {
+    this.timeData = null;
+    this.temperatureData = null;
+    this.humidityData = null;
+    this.brightnessData = null;
+    this.clear();
+  }
+
+  // time is in ms since epoch; samples not newer than the last one are ignored
+  addData(time, temperature, humidity, brightness) {
+    if (time <= this.lastTime) {
+      return;
+    }
+    this.lastTime = time;
+
+    if (!this.hasBuffers()) {
+      this.timeData = new Float64Array(this.maxLen);
+      this.temperatureData = new Float32Array(this.maxLen);
+      this.humidityData = new Float32Array(this.maxLen);
+      this.brightnessData = new Float32Array(this.maxLen);
+    }
+
+    const index = (this.start + this.length) % this.maxLen;
+    this.timeData[index] = time;
+    //History snapshots send a missing reading as null, which a Float32Array would store as 0
+    this.temperatureData[index] = temperature === null ? NaN : temperature;
+    this.humidityData[index] = humidity || NaN;
+    this.brightnessData[index] = brightness || NaN;
+
+    if (this.length < this.maxLen) {
+      this.length += 1;
+    } else {
+      this.start = (this.start + 1) % this.maxLen;
+    }
+  }
+
+  // Most recent value of a buffer, undefined if there is none
+  latest(buffer) {
+    return this.length > 0 ? buffer[(this.start + this.length - 1) % this.maxLen] : undefined;
+  }
+
+  // Add older samples (columns oldest first) in front of the buffered ones, e.g. rollups from the server
+  backfill(columns) {
+    const firstTime = this.length > 0 ? this.timeData[this.start] : Infinity;
+    let older = 0;
+    while (older < columns.time.length && columns.time[older] < firstTime) {
+      older += 1;
+    }
+    if (older === 0) {
+      return;
+    }
+
+    const kept = [];
+    for (let i = 0; i < this.length; ++i) {
+      const index = (this.start + i) % this.maxLen;
+      kept.push([this.timeData[index], this.temperatureData[index], this.humidityData[index], this.brightnessData[index]]);
+    }
+    this.clear();
+    for (let i = 0; i < older; ++i) {
+      this.addData(columns.time[i], columns.temperature[i], columns.humidity[i], columns.brightness[i]);
+    }
+    kept.forEach((sample) => this.addData(...sample));
+  }
+
+  // Decimate each reading into a series (reused typed arrays of at least `threshold` points)
+  decimateTo(threshold, series) {
+    const buffers = [this.temperatureData, this.humidityData, this.brightnessData];
+    series.forEach((line, i) => {
+      // eslint-disable-next-line no-param-reassign
+      line.length = this.hasBuffers() ? lttb(this.timeData, buffers[i], this.start, this.length, threshold, line.x, line.y) : 0;
+    });
+  }
+}
+
+// All the devices in the list (those known to the server), indexed by Id.
+// Only the most recently used devices keep their buffers.
+class TrackedDevices {
+  constructor(maxBuffered) {
+    this.devices = new Map();
+    this.maxBuffered = maxBuffered;
+    this.recentlyUsed = new Map();
+  }
+
+  // Find a device based on its Id
+  findDevice(deviceId) {
+    return this.devices.get(deviceId);
+  }
+
+  addDevice(deviceId) {
+    const device = new DeviceData(deviceId);
+    this.devices.set(deviceId, device);
+    return device;
+  }
+
+  // Mark a device as used, releasing the buffers of the least recently used ones over the limit
+  touch(device) {
+    this.recentlyUsed.delete(device.deviceId);
+    this.recentlyUsed.set(device.deviceId, device);
+    while (this.recentlyUsed.size > this.maxBuffered) {
+      const [oldestId, oldest] = this.recentlyUsed.entries().next().value;
+      this.recentlyUsed.delete(oldestId);
+      oldest.release();
+    }
+  }
+}
+
+const trackedDevices = new TrackedDevices(10);
+let webSocket;
+let lanDevice;
+let selectedDevice;
+let points = 300;
+
+// Send a request to the server once the socket is open
+function sendRequest(request) {
+  if (webSocket && webSocket.readyState === WebSocket.OPEN) {
+    webSocket.send(JSON.stringify(request));
+  }
+}
+
+// Snapshots: at most one per FRAME_MS, and none while the page has not drawn the previous one,
+// so a page that falls behind (or a hidden tab) never builds up a queue
+let dirty = false;
+let awaitingRender = false;
+let snapshotTimer = null;
+let lastSnapshot = 0;
+const spareSeries = [];
+
+function takeSeries() {
+  const line = spareSeries.pop();
+  if (line && line.x.length >= points) {
+    return line;
+  }
+  return { x: new Float64Array(points), y: new Float32Array(points), length: 0 };
+}
+
+function postSnapshot() {
+  snapshotTimer = null;
+  if (!selectedDevice) {
+    return;
+  }
+  dirty = false;
+  awaitingRender = true;
+  lastSnapshot = Date.now();
+
+  const series = [takeSeries(), takeSeries(), takeSeries()];
+  selectedDevice.decimateTo(points, series);
+  const latest = {
+    temperature: selectedDevice.latest(selectedDevice.temperatureData),
+    humidity: selectedDevice.latest(selectedDevice.humidityData),
+    brightness: selectedDevice.latest(selectedDevice.brightnessData),
+  };
+  postMessage({
+    type: 'snapshot', deviceId: selectedDevice.deviceId, latest, series,
+  }, series.flatMap((line) => [line.x.buffer, line.y.buffer]));
+}
+
+function scheduleSnapshot() {
+  if (dirty && !awaitingRender && snapshotTimer === null) {
+    snapshotTimer = setTimeout(postSnapshot, Math.max(0, lastSnapshot + FRAME_MS - Date.now()));
+  }
+}
+
+function markDirty() {
+  dirty = true;
+  scheduleSnapshot();
+}
+
+// Devices not yet announced to the page, posted once the current message is handled
+let newDeviceIds = [];
+
+// Find a tracked device, adding it if it is new
+function getOrAddDevice(deviceId) {
+  const existingDeviceData = trackedDevices.findDevice(deviceId);
+  if (existingDeviceData) {
+    return existingDeviceData;
+  }
+  newDeviceIds.push(deviceId);
+  return trackedDevices.addDevice(deviceId);
+}
+
+function selectDevice(deviceId) {
+  const device = getOrAddDevice(deviceId);
+  if (device !== selectedDevice) {
+    if (selectedDevice) {
+      sendRequest({ Type: 'unsubscribe', DeviceIds: [selectedDevice.deviceId] });
+    }
+    selectedDevice = device;
+    sendRequest({ Type: 'subscribe', DeviceIds: [device.deviceId] });
+  }
+  trackedDevices.touch(device);
+  markDirty();
+}
+
+// Devices known to the server (sent on connect, then as new ones appear), with the indexes binary frames use
+const deviceIdsByIndex = [];
+function onDevices(messageData) {
+  messageData.DeviceIds.forEach(getOrAddDevice);
+  if (Array.isArray(messageData.Indexes)) {
+    messageData.Indexes.forEach((index, i) => {
+      deviceIdsByIndex[index] = messageData.DeviceIds[i];
+    });
+  }
+}
+
+// The server only keeps the last hour of raw samples; fill the rest of the day from its 1 minute rollups
+function backfillDevice(device) {
+  if (lanDevice) {
+    return;
+  }
+  const since = Date.now() - device.maxLen * 5000;
+  fetch(`/api/history/${encodeURIComponent(device.deviceId)}?resolution=1m&since=${since}`)
+    .then((response) => (response.ok ? response.json() : undefined))
+    .then((snapshot) => {
+      if (snapshot && device.hasBuffers()) {
+        device.backfill(snapshot.Columns);
+        if (device === selectedDevice) {
+          markDirty();
+        }
+      }
+    })
+    .catch((err) => console.error(err));
+}
+
+// Replace a device's buffers with the history the server sends when it is subscribed to
+function onHistory(messageData) {
+  const device = getOrAddDevice(messageData.DeviceId);
+  const columns = messageData.Columns;
+  device.clear();
+  for (let i = 0; i < columns.time.length; ++i) {
+    device.addData(columns.time[i], columns.temperature[i], columns.humidity[i], columns.brightness[i]);
+  }
+
+  if (device === selectedDevice) {
+    markDirty();
+    backfillDevice(device);
+  }
+}
+
+// Append a sample to its device, returns the device
+function addSample(deviceId, time, temperature, humidity, brightness) {
+  // find or add device to list of tracked devices
+  const device = getOrAddDevice(deviceId);
+  // late messages of a device that was unselected and released are not worth buffers
+  if (device !== selectedDevice && !device.hasBuffers()) {
+    return device;
+  }
+  device.addData(time, temperature, humidity, brightness);
+  return device;
+}
+
+// Validate a telemetry message and append it to its device, returns the device (undefined if skipped)
+function onTelemetry(messageData) {
+  // either temperature or humidity is required; a device streaming on the LAN has no MessageDate, it is stamped on arrival
+  if (!messageData.IotData || (!messageData.IotData.temperature && !messageData.IotData.humidity && !messageData.IotData.brightness)) {
+    return undefined;
+  }
+  if (!messageData.MessageDate && !lanDevice) {
+    return undefined;
+  }
+  const time = messageData.MessageDate ? new Date(messageData.MessageDate).getTime() : Date.now();
+  return addSample(messageData.DeviceId, time,
+    messageData.IotData.temperature, messageData.IotData.humidity, messageData.IotData.brightness);
+}
+
+// A columnar binary batch (layout in scripts/telemetry-frame.js): the columns are mapped as typed
+// arrays (little endian, like every browser host) instead of parsing one JSON object per sample.
+// Returns true if it touched the selected device.
+function onBinaryBatch(buffer) {
+  const header = new DataView(buffer);
+  if (header.getUint8(0) !== 1 || header.getUint8(1) !== 1) {
+    return false;
+  }
+  const count = header.getUint32(4, true);
+  let offset = 8;
+  const time = new Float64Array(buffer, offset, count);
+  offset += count * 8;
+  const temperature = new Float32Array(buffer, offset, count);
+  offset += count * 4;
+  const humidity = new Float32Array(buffer, offset, count);
+  offset += count * 4;
+  const brightness = new Float32Array(buffer, offset, count);
+  offset += count * 4;
+  const devices = new Uint32Array(buffer, offset, count);
+
+  let selectedUpdated = false;
+  for (let i = 0; i < count; ++i) {
+    const deviceId = deviceIdsByIndex[devices[i]];
+    if (deviceId !== undefined && !(Number.isNaN(temperature[i]) && Number.isNaN(humidity[i]) && Number.isNaN(brightness[i]))) {
+      if (addSample(deviceId, time[i], temperature[i], humidity[i], brightness[i]) === selectedDevice) {
+        selectedUpdated = true;
+      }
+    }
+  }
+  return selectedUpdated;
+}
+
+// When a web socket message arrives:
+// 1. Unpack it (a batch holds the selected device's messages the server received in one tick,
+//    as JSON or as a binary frame)
+// 2. Validate it has date/time and temperature
+// 3. Find or create a cached device to hold the telemetry data
+// 4. Append the telemetry data
+// 5. Mark a snapshot due, if it touched the selected device
+function onSocketMessage(message) {
+  let selectedUpdated = false;
+  if (message.data instanceof ArrayBuffer) {
+    selectedUpdated = onBinaryBatch(message.data);
+  } else {
+    const messageData = JSON.parse(message.data);
+    if (messageData.Type === 'devices') {
+      onDevices(messageData);
+    } else if (messageData.Type === 'history') {
+      onHistory(messageData);
+    } else if (messageData.Type === 'resync') {
+      // The server dropped telemetry while this page was behind: the history snapshot fills the gap
+      if (selectedDevice) {
+        sendRequest({ Type: 'unsubscribe', DeviceIds: [selectedDevice.deviceId] });
+        sendRequest({ Type: 'subscribe', DeviceIds: [selectedDevice.deviceId] });
+      }
+    } else if (messageData.Type === 'alert' || messageData.Type === 'alerts') {
+      postMessage({
+        type: 'alerts',
+        alerts: messageData.Type === 'alerts' ? messageData.Alerts : [messageData],
+        reset: messageData.Type === 'alerts',
+      });
+    } else {
+      const messages = messageData.Type === 'batch' ? messageData.Messages : [messageData];
+      messages.forEach((telemetry) => {
+        if (onTelemetry(telemetry) === selectedDevice) {
+          selectedUpdated = true;
+        }
+      });
+    }
+  }
+
+  if (newDeviceIds.length > 0) {
+    postMessage({ type: 'devices', deviceIds: newDeviceIds });
+    newDeviceIds = [];
+  }
+  if (selectedUpdated && selectedDevice) {
+    markDirty();
+  }
+}
+
+function connect(request) {
+  lanDevice = request.lanDevice;
+  points = request.points;
+  webSocket = new WebSocket(request.url, request.protocols);
+  webSocket.binaryType = 'arraybuffer';
+  webSocket.onopen = function onOpen() {
+    if (selectedDevice) {
+      sendRequest({ Type: 'subscribe', DeviceIds: [selectedDevice.deviceId] });
+    }
+  };
+  webSocket.onmessage = function onMessage(message) {
+    try {
+      onSocketMessage(message);
+    } catch (err) {
+      console.error(err);
+    }
+  };
+}
+
+self.onmessage = function onPageMessage(event) {
+  const request = event.data;
+  if (request.type === 'connect') {
+    connect(request);
+  } else if (request.type === 'select') {
+    selectDevice(request.deviceId);
+  } else if (request.type === 'points') {
+    points = request.points;
+    markDirty();
+  } else if (request.type === 'rendered') {
+    awaitingRender = false;
+    spareSeries.push(...request.series);
+    scheduleSnapshot();
+  }
+};
@@ -0,0 +1,231 @@
+// End-to-end benchmark: runs the server against a simulated fleet (MessageSource=synthetic) and
+// connects a swarm of headless dashboards, then reports delivery latency, throughput and server memory.
+//
+//   npm run bench -- --devices 1000 --rate 0.2 --clients 50 --duration 30
+//
+// Options:
+//   --devices <n>       simulated devices (default 100)
+//   --rate <n>          messages per second per device (default 0.2, the firmware's 5 second interval)
+//   --clients <n>       WebSocket clients (default 10)
+//   --subscribe <n>     devices each client subscribes to, 0 for every device (default 0)
+//   --duration <s>      measured seconds (default 30), after --warmup <s> (default 5)
+//   --port <n>          port for the spawned server (default 3100)
+//   --workers <n>       ClusterWorkers for the spawned server (default 1)
+//   --binary            clients negotiate the binary telemetry protocol instead of JSON
+//   --no-deflate        clients do not offer permessage-deflate
+//   --url <ws url>      benchmark an already running server instead (its memory is read from /metrics)
+
+const { spawn } = require('child_process');
+const http = require('http');
+const path = require('path');
+const minimist = require('minimist');
+const WebSocket = require('ws');
+const { BINARY_PROTOCOL } = require('./telemetry-frame.js');
+
+const args = minimist(process.argv.slice(2), { boolean: ['binary', 'deflate'], default: { deflate: true } });
+const options = {
+  devices: Number(args.devices) || 100,
+  rate: Number(args.rate) || 0.2,
+  clients: Number(args.clients) || 10,
+  subscribe: Number(args.subscribe) || 0,
+  duration: Number(args.duration) || 30,
+  warmup: args.warmup !== undefined ? Number(args.warmup) : 5,
+  port: Number(args.port) || 3100,
+  workers: Number(args.workers) || 1,
+  binary: args.binary,
+  deflate: args.deflate,
+};
+
+function startServer() {
+  return new Promise((resolve, reject) => {
+    let listening = 0;
+    const server = spawn(process.execPath, [path.join(__dirname, '..', 'server.js')], {
+      env: {
+        ...process.env,
+        MessageSource: 'synthetic',
+        SyntheticDevices: String(options.devices),
+        SyntheticRatePerDevice: String(options.rate),
+        PORT: String(options.port),
+        ClusterWorkers: String(options.workers),
+        CheckpointFile: 'none',
+        MetricsLogIntervalSeconds: String(24 * 60 * 60),
+      },
+      stdio: ['ignore', 'pipe', 'inherit'],
+    });
+    server.on('exit', (code) => reject(new Error(`Server exited with code ${code}`)));
+    server.stdout.on('data', (data) => {
+      // In cluster mode, wait for every worker
+      listening += (data.toString().match(/Listening on/g) || []).length;
+      if (listening === options.workers) {
+        resolve(server);
+      }
+    });
+  });
+}
+
+function getJson(url) {
+  return new Promise((resolve, reject) => {
+    http.get(url, (res) => {
+      let body = '';
+      res.on('data', (chunk) => { body += chunk; });
+      res.on('end', () => {
+        try {
+          resolve(JSON.parse(body));
+        } catch (err) {
+          reject(err);
+        }
+      });
+    }).on('error', reject);
+  });
+}
+
+// A headless dashboard; records the delivery latency of every telemetry message once measuring starts
+class BenchClient {
+  constructor(url, stats) {
+    this.stats = stats;
+    this.subscribed = 0;
+    this.ws = new WebSocket(url, options.binary ? [BINARY_PROTOCOL] : [], { perMessageDeflate: options.deflate });
+    this.ws.on('message', (data, isBinary) => this.onMessage(data, isBinary));
+    this.ws.on('error', (err) => { stats.errors += 1; console.error(err.message); });
+    this.opened = new Promise((resolve) => this.ws.on('open', resolve));
+    this.opened.then(() => {
+      if (options.subscribe === 0) {
+        this.send({ Type: 'subscribe', DeviceIds: ['*'] });
+      }
+    });
+  }
+
+  send(request) {
+    this.ws.send(JSON.stringify(request));
+  }
+
+  // Bytes received on the wire (compressed), for bandwidth per client
+  wireBytes() {
+    // eslint-disable-next-line no-underscore-dangle
+    return this.ws._socket ? this.ws._socket.bytesRead : 0;
+  }
+
+  onMessage(data, isBinary) {
+    const received = Date.now();
+    const { stats } = this;
+    // ws 8 tells binary from text frames, older versions hand text frames over as strings
+    const binary = isBinary !== undefined ? isBinary : typeof data !== 'string';
+    if (binary && data[0] === 1 && data[1] === 1) {
+      if (stats.measuring) {
+        // Only the time column is needed (layout in telemetry-frame.js)
+        const count = data.readUInt32LE(4);
+        stats.frames += 1;
+        stats.bytes += data.length;
+        for (let i = 0; i < count; ++i) {
+          stats.latencies.push(received - data.readDoubleLE(8 + i * 8));
+        }
+      }
+      return;
+    }
+    const message = JSON.parse(data);
+    if (message.Type === 'devices') {
+      // Pick random devices from the first announcements until the client has enough
+      if (options.subscribe > 0 && this.subscribed < options.subscribe) {
+        const candidates = message.DeviceIds.slice();
+        const picked = [];
+        while (candidates.length > 0 && this.subscribed + picked.length < options.subscribe) {
+          picked.push(candidates.splice(Math.floor(Math.random() * candidates.length), 1)[0]);
+        }
+        if (picked.length > 0) {
+          this.subscribed += picked.length;
+          this.send({ Type: 'subscribe', DeviceIds: picked });
+        }
+      }
+      return;
+    }
+    if (!stats.measuring) {
+      return;
+    }
+
+    stats.frames += 1;
+    stats.bytes += data.length;
+    const messages = message.Type === 'batch' ? message.Messages : [message];
+    messages.forEach((telemetry) => {
+      if (telemetry.MessageDate) {
+        stats.latencies.push(received - Date.parse(telemetry.MessageDate));
+      }
+    });
+  }
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) {
+    return NaN;
+  }
+  return sorted[Math.min(sorted.length - 1, Math.floor((p / 100) * sorted.length))];
+}
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+const mb = (bytes) => (bytes / (1024 * 1024)).toFixed(1);
+
+async function main() {
+  const server = args.url ? undefined : await startServer();
+  const url = args.url || `ws://localhost:${options.port}`;
+  const metricsUrl = `${url.replace(/^ws/, 'http').replace(/\/$/, '')}/metrics`;
+
+  const stats = {
+    measuring: false, frames: 0, bytes: 0, errors: 0, latencies: [], rssMax: 0, heapMax: 0,
+  };
+  const clients = [];
+  for (let i = 0; i < options.clients; ++i) {
+    clients.push(new BenchClient(url, stats));
+  }
+  await Promise.all(clients.map((client) => client.opened));
+  console.log('%d clients connected to %s, warming up for %ds.', clients.length, url, options.warmup);
+  await sleep(options.warmup * 1000);
+
+  const sampler = setInterval(() => {
+    getJson(metricsUrl).then((metrics) => {
+      stats.rssMax = Math.max(stats.rssMax, metrics.memory.rss);
+      stats.heapMax = Math.max(stats.heapMax, metrics.memory.heapUsed);
+      stats.broadcast = metrics.broadcast;
+    }).catch(() => {});
+  }, 1000);
+  const wireBytes = () => clients.reduce((total, client) => total + client.wireBytes(), 0);
+  const wireStart = wireBytes();
+  stats.measuring = true;
+  const start = Date.now();
+  await sleep(options.duration * 1000);
+  stats.measuring = false;
+  const seconds = (Date.now() - start) / 1000;
+  const wire = wireBytes() - wireStart;
+  clearInterval(sampler);
+
+  const sorted = Float64Array.from(stats.latencies).sort();
+  console.log('');
+  console.log('Fleet:      %d devices at %d msg/s (%d msg/s into the server)', options.devices, options.rate, options.devices * options.rate);
+  console.log('Clients:    %d, each subscribed to %s, %s frames%s', options.clients,
+    options.subscribe === 0 ? 'every device' : `${options.subscribe} devices`,
+    clients[0].ws.protocol === BINARY_PROTOCOL ? 'binary' : 'JSON', clients[0].ws.extensions.includes('permessage-deflate') ? ' with permessage-deflate' : '');
+  console.log('Delivered:  %d messages in %d frames over %ds: %d msg/s, %d frames/s, %s MB/s',
+    sorted.length, stats.frames, seconds, Math.round(sorted.length / seconds), Math.round(stats.frames / seconds), mb(stats.bytes / seconds));
+  console.log('Bandwidth:  %s KB/s per client on the wire, %d bytes per message (%d before compression)',
+    (wire / seconds / options.clients / 1024).toFixed(1), Math.round(wire / (sorted.length || 1)), Math.round(stats.bytes / (sorted.length || 1)));
+  console.log('Latency:    p50 %dms  p90 %dms  p99 %dms  max %dms',
+    percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), sorted.length ? sorted[sorted.length - 1] : NaN);
+  console.log('Server:     rss max %s MB, heap max %s MB%s', mb(stats.rssMax), mb(stats.heapMax), options.workers > 1 ? ' (one worker)' : '');
+  if (stats.broadcast) {
+    console.log('Broadcast:  %d sends, %d coalesced, %d dropped, fan-out avg %dus max %dus',
+      stats.broadcast.sends, stats.broadcast.coalesced, stats.broadcast.dropped,
+      Math.round(stats.broadcast.fanoutUsAvg), Math.round(stats.broadcast.fanoutUsMax));
+  }
+  if (stats.errors > 0) {
+    console.log('Errors:     %d client errors', stats.errors);
+  }
+
+  clients.forEach((client) => client.ws.terminate());
+  if (server) {
+    server.removeAllListeners('exit');
+    server.kill('SIGTERM');
+  }
+}
+
+main().catch((err) => {
+  console.error(err.message || err);
+  process.exit(1);
+});
@@ -0,0 +1,274 @@
+const WebSocket = require('ws');
+
+// Fans messages out to connected WebSocket clients.
+//
+// Subscriptions: clients subscribe to the DeviceIds they watch ('*' for every device), and a
+// device→clients index sends each device's messages only to interested sockets.
+//
+// Encodings: each message is serialized once per encoding; clients that negotiated
+// options.binaryProtocol get data.toBinary() when the data has one, everyone else gets its JSON.
+//
+// Coalescing and resync: a client may only have a few sends in flight. While it is behind, newer
+// messages replace its pending one, so a slow dashboard never grows an unbounded buffer. A dropped
+// message is a whole batch of samples, so the client then gets a {Type: 'resync'} marker and
+// re-requests the history of the devices it shows.
+//
+// Queue: messages sent with { coalesce: false } (alerts, device announcements) wait in a per-client
+// FIFO ahead of the pending message; a client that fills it (options.maxQueued) is disconnected.
+// With optional: true (history snapshots) they are skipped for a resync marker instead when they
+// would take the client past options.maxBufferedBytes.
+const RESYNC = JSON.stringify({ Type: 'resync' });
+
+class Broadcaster {
+  constructor(wss, options = {}) {
+    this.wss = wss;
+    this.maxInFlight = options.maxInFlight || 8;
+    this.maxBufferedBytes = options.maxBufferedBytes || 1024 * 1024;
+    this.maxQueued = options.maxQueued || 256;
+    this.binaryProtocol = options.binaryProtocol;
+    this.clients = new Map();
+    this.subscribers = new Map();
+    this.wildcard = new Set();
+    this.resetMetrics();
+
+    wss.on('connection', (ws) => {
+      const binary = Boolean(this.binaryProtocol) && ws.protocol === this.binaryProtocol;
+      this.clients.set(ws, {
+        inFlight: 0, queue: [], queuedBytes: 0, pending: null, resync: false, devices: new Set(), binary,
+      });
+      ws.on('close', () => {
+        this.unsubscribe(ws, Array.from(this.clients.get(ws).devices));
+        this.wildcard.delete(ws);
+        this.clients.delete(ws);
+      });
+    });
+  }
+
+  // Returns the DeviceIds the client was not already subscribed to
+  subscribe(ws, deviceIds) {
+    const state = this.clients.get(ws);
+    if (!state) {
+      return [];
+    }
+
+    const added = [];
+    deviceIds.forEach((deviceId) => {
+      if (deviceId === '*') {
+        this.wildcard.add(ws);
+      } else if (!state.devices.has(deviceId)) {
+        state.devices.add(deviceId);
+        if (!this.subscribers.has(deviceId)) {
+          this.subscribers.set(deviceId, new Set());
+        }
+        this.subscribers.get(deviceId).add(ws);
+        added.push(deviceId);
+      }
+    });
+    return added;
+  }
+
+  unsubscribe(ws, deviceIds) {
+    const state = this.clients.get(ws);
+    if (!state) {
+      return;
+    }
+
+    deviceIds.forEach((deviceId) => {
+      if (deviceId === '*') {
+        this.wildcard.delete(ws);
+        return;
+      }
+      state.devices.delete(deviceId);
+      const clients = this.subscribers.get(deviceId);
+      if (clients) {
+        clients.delete(ws);
+        if (clients.size === 0) {
+          this.subscribers.delete(deviceId);
+        }
+      }
+    });
+  }
+
+  hasWildcardSubscribers() {
+    return this.wildcard.size > 0;
+  }
+
+  // Every connected client
+  broadcast(data, options = {}) {
+    this.fanOut(this.clients.keys(), data, options);
+  }
+
+  // One client
+  send(ws, data, options = {}) {
+    this.fanOut([ws], data, options);
+  }
+
+  // Clients subscribed to deviceId (wildcard subscribers get the whole batch instead, see publishAll)
+  publish(deviceId, data) {
+    const clients = this.subscribers.get(deviceId);
+    if (clients) {
+      this.fanOut(Array.from(clients).filter((client) => !this.wildcard.has(client)), data);
+    }
+  }
+
+  // Clients subscribed to every device
+  publishAll(data) {
+    this.fanOut(this.wildcard, data);
+  }
+
+  fanOut(clients, data, options = {}) {
+    const start = process.hrtime.bigint();
+    let text;
+    let binary;
+
+    for (const client of clients) {
+      // Serialize lazily, and only once per encoding
+      const state = this.clients.get(client);
+      let payload;
+      if (state && state.binary && typeof data.toBinary === 'function') {
+        if (binary === undefined) {
+          binary = data.toBinary();
+        }
+        payload = binary;
+      } else {
+        if (text === undefined) {
+          text = typeof data === 'string' ? data : JSON.stringify(data);
+        }
+        payload = text;
+      }
+      this.sendTo(client, state, payload, options);
+    }
+
+    if (text !== undefined || binary !== undefined) {
+      const elapsedUs = Number(process.hrtime.bigint() - start) / 1000;
+      this.metrics.messages += 1;
+      this.metrics.fanoutUsTotal += elapsedUs;
+      this.metrics.fanoutUsMax = Math.max(this.metrics.fanoutUsMax, elapsedUs);
+    }
+  }
+
+  sendTo(client, state, payload, options = {}) {
+    if (!state || client.readyState !== WebSocket.OPEN) {
+      return;
+    }
+
+    const coalesce = options.coalesce !== false;
+    if (!coalesce) {
+      if (options.optional && client.bufferedAmount + state.queuedBytes + payload.length > this.maxBufferedBytes) {
+        this.metrics.skipped += 1;
+        state.resync = true;
+        return;
+      }
+      if (state.queue.length >= this.maxQueued) {
+        this.metrics.evicted += 1;
+        client.terminate();
+        return;
+      }
+      state.queue.push(payload);
+      state.queuedBytes += payload.length;
+    } else {
+      if (state.pending !== null) {
+        this.metrics.dropped += 1;
+        state.resync = true;
+      }
+      state.pending = payload;
+    }
+    this.flush(client, state);
+    if (coalesce && state.pending === payload) {
+      this.metrics.coalesced += 1;
+    }
+  }
+
+  isBehind(client, state) {
+    return (state.inFlight >= this.maxInFlight) || (client.bufferedAmount > this.maxBufferedBytes);
+  }
+
+  // Send what the client is waiting for while it keeps up: the queue first, then the resync marker
+  // if something was dropped, then the pending message
+  flush(client, state) {
+    while (client.readyState === WebSocket.OPEN && !this.isBehind(client, state)) {
+      let payload;
+      if (state.queue.length > 0) {
+        payload = state.queue.shift();
+        state.queuedBytes -= payload.length;
+      } else if (state.resync) {
+        payload = RESYNC;
+        state.resync = false;
+        this.metrics.resyncs += 1;
+      } else if (state.pending !== null) {
+        payload = state.pending;
+        state.pending = null;
+      } else {
+        return;
+      }
+      this.transmit(client, state, payload);
+    }
+  }
+
+  transmit(client, state, payload) {
+    state.inFlight += 1;
+    this.metrics.sends += 1;
+    this.metrics.bytes += payload.length;
+    client.send(payload, (err) => {
+      state.inFlight -= 1;
+      if (err) {
+        this.metrics.errors += 1;
+        return;
+      }
+      this.flush(client, state);
+    });
+  }
+
+  resetMetrics() {
+    this.metrics = {
+      since: Date.now(),
+      messages: 0,
+      sends: 0,
+      coalesced: 0,
+      dropped: 0,
+      evicted: 0,
+      skipped: 0,
+      resyncs: 0,
+      errors: 0,
+      bytes: 0,
+      fanoutUsTotal: 0,
+      fanoutUsMax: 0,
+    };
+  }
+
+  // Counters since the last reset, plus the current backlog of slow clients
+  getMetrics() {
+    let inFlight = 0;
+    let pending = 0;
+    let queued = 0;
+    this.clients.forEach((state) => {
+      inFlight += state.inFlight;
+      pending += state.pending !== null ? 1 : 0;
+      queued += state.queue.length;
+    });
+
+    const { metrics } = this;
+    return {
+      clients: this.clients.size,
+      subscribedDevices: this.subscribers.size,
+      wildcardClients: this.wildcard.size,
+      inFlight,
+      pending,
+      queued,
+      seconds: (Date.now() - metrics.since) / 1000,
+      messages: metrics.messages,
+      sends: metrics.sends,
+      coalesced: metrics.coalesced,
+      dropped: metrics.dropped,
+      evicted: metrics.evicted,
+      skipped: metrics.skipped,
+      resyncs: metrics.resyncs,
+      errors: metrics.errors,
+      bytes: metrics.bytes,
+      fanoutUsAvg: metrics.messages ? metrics.fanoutUsTotal / metrics.messages : 0,
+      fanoutUsMax: metrics.fanoutUsMax,
+    };
+  }
+}
+
+module.exports = Broadcaster;
@@ -0,0 +1,110 @@
+// Builds public/ into dist/ for production serving (npm run build):
+// - every asset except HTML pages gets a content hash in its name (js/chart-device-data.<hash>.js),
+//   so it can be cached as immutable; references in HTML and CSS are rewritten to the hashed names
+// - text assets get precompressed .gz and .br siblings, so the server never compresses on the fly
+// - dist/asset-manifest.json maps each source path to its hashed path
+
+const crypto = require('crypto');
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+
+const sourceDir = path.join(__dirname, '..', 'public');
+const outputDir = path.join(__dirname, '..', 'dist');
+const compressible = new Set(['.html', '.js', '.css', '.svg', '.json', '.txt']);
+
+function listFiles(dir, prefix = '') {
+  return fs.readdirSync(dir, { withFileTypes: true }).reduce((files, entry) => {
+    const relative = path.posix.join(prefix, entry.name);
+    return files.concat(entry.isDirectory() ? listFiles(path.join(dir, entry.name), relative) : [relative]);
+  }, []);
+}
+
+// fs.rmSync needs Node 14.14
+function removeDir(dir) {
+  if (!fs.existsSync(dir)) {
+    return;
+  }
+  fs.readdirSync(dir, { withFileTypes: true }).forEach((entry) => {
+    const target = path.join(dir, entry.name);
+    if (entry.isDirectory()) {
+      removeDir(target);
+    } else {
+      fs.unlinkSync(target);
+    }
+  });
+  fs.rmdirSync(dir);
+}
+
+// Replace references to assets that were already hashed, resolved relative to the referencing file
+function rewriteReferences(file, text, manifest) {
+  const dir = path.posix.dirname(file);
+  const rewrite = (reference) => {
+    const target = path.posix.normalize(path.posix.join(dir, decodeURI(reference)));
+    return manifest[target] ? encodeURI(path.posix.relative(dir, manifest[target])) : reference;
+  };
+  const isLocal = (reference) => !/^([a-z]+:|\/\/|#|data:)/i.test(reference);
+
+  if (file.endsWith('.css')) {
+    return text.replace(/url\(\s*(['"]?)([^'")]+)\1\s*\)/g,
+      (match, quote, reference) => (isLocal(reference) ? `url(${quote}${rewrite(reference)}${quote})` : match));
+  }
+  return text.replace(/\b(src|href)="([^"]+)"/g,
+    (match, attribute, reference) => (isLocal(reference) ? `${attribute}="${rewrite(reference)}"` : match));
+}
+
+function writeOutput(file, content) {
+  const target = path.join(outputDir, file);
+  fs.mkdirSync(path.dirname(target), { recursive: true });
+  fs.writeFileSync(target, content);
+  let size = `${content.length} B`;
+
+  if (compressible.has(path.extname(file).toLowerCase())) {
+    const gzip = zlib.gzipSync(content, { level: zlib.constants.Z_BEST_COMPRESSION });
+    const brotli = zlib.brotliCompressSync(content, {
+      params: {
+        [zlib.constants.BROTLI_PARAM_QUALITY]: zlib.constants.BROTLI_MAX_QUALITY,
+        [zlib.constants.BROTLI_PARAM_SIZE_HINT]: content.length,
+      },
+    });
+    if (gzip.length < content.length) {
+      fs.writeFileSync(`${target}.gz`, gzip);
+      size += `, gzip ${gzip.length} B`;
+    }
+    if (brotli.length < content.length) {
+      fs.writeFileSync(`${target}.br`, brotli);
+      size += `, brotli ${brotli.length} B`;
+    }
+  }
+  console.log('%s (%s)', file, size);
+}
+
+function build() {
+  removeDir(outputDir);
+
+  // Leaves first: plain assets, then stylesheets (which may reference them), then pages
+  const rank = (file) => ({ '.css': 1, '.html': 2 }[path.extname(file).toLowerCase()] || 0);
+  const files = listFiles(sourceDir).sort((a, b) => rank(a) - rank(b) || a.localeCompare(b));
+  const manifest = {};
+
+  files.forEach((file) => {
+    const extension = path.extname(file).toLowerCase();
+    let content = fs.readFileSync(path.join(sourceDir, file));
+    if (extension === '.css' || extension === '.html') {
+      content = Buffer.from(rewriteReferences(file, content.toString('utf8'), manifest), 'utf8');
+    }
+
+    // Pages keep their names (they are the entry points, revalidated on every load)
+    let output = file;
+    if (extension !== '.html') {
+      const hash = crypto.createHash('sha256').update(content).digest('hex').slice(0, 10);
+      output = `${file.slice(0, file.length - extension.length)}.${hash}${extension}`;
+      manifest[file] = output;
+    }
+    writeOutput(output, content);
+  });
+
+  fs.writeFileSync(path.join(outputDir, 'asset-manifest.json'), `${JSON.stringify(manifest, null, 2)}\n`);
+}
+
+build();
@@ -0,0 +1,89 @@
+const cluster = require('cluster');
+
+// Pub/sub between the Node cluster primary and its workers, over the cluster IPC channel.
+// The primary runs the only Event Hub reader and publishes its batches; every worker receives all
+// of them and fans them out to its own WebSocket clients (the OS spreads connections over workers).
+// A bus for several hosts (e.g. Redis) would offer the same publish() and subscriber interface.
+
+const BATCH = 'telemetry-batch';
+
+// Primary side: forks the workers (restarting any that die) and sends each batch to all of them
+class ClusterPublisher {
+  constructor(workerCount) {
+    this.stopping = false;
+    for (let i = 0; i < workerCount; ++i) {
+      cluster.fork();
+    }
+    cluster.on('exit', (worker, code, signal) => {
+      if (!this.stopping) {
+        console.error('Worker %d exited (%s), starting a new one.', worker.id, signal || code);
+        cluster.fork();
+      }
+    });
+  }
+
+  publish(batch) {
+    Object.values(cluster.workers).forEach((worker) => {
+      if (worker.isConnected()) {
+        worker.send({ Type: BATCH, Batch: batch });
+      }
+    });
+  }
+
+  // Ask the workers to shut down (closing their clients) and wait for them to exit
+  stop(timeoutMs = 5000) {
+    this.stopping = true;
+    const workers = Object.values(cluster.workers);
+    return new Promise((resolve) => {
+      let running = workers.length;
+      if (running === 0) {
+        resolve();
+        return;
+      }
+      const timer = setTimeout(resolve, timeoutMs);
+      workers.forEach((worker) => {
+        worker.on('exit', () => {
+          running -= 1;
+          if (running === 0) {
+            clearTimeout(timer);
+            resolve();
+          }
+        });
+        worker.process.kill('SIGTERM');
+      });
+    });
+  }
+}
+
+// Worker side: has the reader interface, so the server handles published batches like Event Hub ones
+class ClusterSubscriber {
+  constructor() {
+    this.listener = undefined;
+  }
+
+  // Calls startReadMessageCallback(message, date, deviceId) once per message
+  async startReadMessage(startReadMessageCallback) {
+    await this.startReadMessageBatch((batch) => {
+      batch.forEach(({ message, date, deviceId }) => startReadMessageCallback(message, date, deviceId));
+    });
+  }
+
+  // Calls startReadBatchCallback([{ message, date, deviceId }, ...]) once per published batch
+  async startReadMessageBatch(startReadBatchCallback) {
+    this.listener = (message) => {
+      if (message && message.Type === BATCH) {
+        startReadBatchCallback(message.Batch);
+      }
+    };
+    process.on('message', this.listener);
+  }
+
+  async stopReadMessage() {
+    if (this.listener) {
+      process.removeListener('message', this.listener);
+      this.listener = undefined;
+    }
+  }
+}
+
+module.exports = { ClusterPublisher, ClusterSubscriber };
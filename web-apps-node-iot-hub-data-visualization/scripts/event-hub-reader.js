@@ -2,51 +2,126 @@
  * Microsoft Sample Code - Copyright (c) 2020 - Licensed MIT
  */
 
-const { EventHubProducerClient, EventHubConsumerClient } = require('@azure/event-hubs');
+const { EventHubConsumerClient, earliestEventPosition, latestEventPosition } = require('@azure/event-hubs');
 const { convertIotHubToEventHubsConnectionString } = require('./iot-hub-connection-string.js');
+const FileCheckpointStore = require('./file-checkpoint-store.js');
+
+// Where to start reading partitions that have no checkpoint yet: 'latest', 'earliest' or a date
+function toEventPosition(startPosition) {
+  if (!startPosition || startPosition === 'latest') {
+    return latestEventPosition;
+  }
+  if (startPosition === 'earliest') {
+    return earliestEventPosition;
+  }
+  const enqueuedOn = new Date(startPosition);
+  if (Number.isNaN(enqueuedOn.getTime())) {
+    throw new Error(`Invalid start position [${startPosition}], expected 'latest', 'earliest' or a date.`);
+  }
+  return { enqueuedOn };
+}
 
 class EventHubReader {
-  constructor(iotHubConnectionString, consumerGroup) {
+  // options.checkpointFile: file to keep per-partition checkpoints in (none: always start at startPosition)
+  // options.startPosition: 'latest' (default), 'earliest' or a date, for partitions without a checkpoint
+  // options.checkpointIntervalMs: how often each partition's checkpoint is written
+  constructor(iotHubConnectionString, consumerGroup, options = {}) {
     this.iotHubConnectionString = iotHubConnectionString;
     this.consumerGroup = consumerGroup;
+    this.checkpointStore = options.checkpointFile ? new FileCheckpointStore(options.checkpointFile) : undefined;
+    this.startPosition = toEventPosition(options.startPosition);
+    this.checkpointIntervalMs = options.checkpointIntervalMs || 5000;
+    this.consumerClient = undefined;
+    this.subscription = undefined;
+    // Last processed event of each partition and when it was checkpointed
+    this.partitions = new Map();
   }
 
+  // Calls startReadMessageCallback(message, date, deviceId) once per event
   async startReadMessage(startReadMessageCallback) {
+    await this.startReadMessageBatch((batch) => {
+      batch.forEach(({ message, date, deviceId }) => startReadMessageCallback(message, date, deviceId));
+    });
+  }
+
+  // Calls startReadBatchCallback([{ message, date, deviceId }, ...]) once per partition batch
+  async startReadMessageBatch(startReadBatchCallback) {
     try {
       const eventHubConnectionString = await convertIotHubToEventHubsConnectionString(this.iotHubConnectionString);
-      const consumerClient = new EventHubConsumerClient(this.consumerGroup, eventHubConnectionString);
+      this.consumerClient = this.checkpointStore
+        ? new EventHubConsumerClient(this.consumerGroup, eventHubConnectionString, this.checkpointStore)
+        : new EventHubConsumerClient(this.consumerGroup, eventHubConnectionString);
       console.log('Successfully created the EventHubConsumerClient from IoT Hub event hub-compatible connection string.');
 
-      const partitionIds = await consumerClient.getPartitionIds();
+      const partitionIds = await this.consumerClient.getPartitionIds();
       console.log('The partition ids are: ', partitionIds);
 
-      consumerClient.subscribe({
-        processEvents: (events, context) => {
-          for (let i = 0; i < events.length; ++i) {
-            startReadMessageCallback(
-              events[i].body,
-              events[i].enqueuedTimeUtc,
-              events[i].systemProperties["iothub-connection-device-id"]);
+      this.subscription = this.consumerClient.subscribe({
+        processEvents: async (events, context) => {
+          if (events.length === 0) {
+            return;
           }
+          startReadBatchCallback(events.map((event) => ({
+            message: event.body,
+            date: event.enqueuedTimeUtc,
+            deviceId: event.systemProperties["iothub-connection-device-id"],
+          })));
+          await this.checkpoint(context, events[events.length - 1], false);
         },
         processError: (err, context) => {
           console.error(err.message || err);
         }
+      }, {
+        startPosition: this.startPosition,
+        maxBatchSize: 100,
+        maxWaitTimeInSeconds: 1,
       });
     } catch (ex) {
       console.error(ex.message || ex);
     }
   }
 
-  // Close connection to Event Hub.
+  // Record the last processed event of a partition, writing it at most once per checkpointIntervalMs
+  async checkpoint(context, event, force) {
+    if (!this.checkpointStore) {
+      return;
+    }
+
+    const partition = this.partitions.get(context.partitionId) || { checkpointedAt: 0 };
+    partition.context = context;
+    partition.event = event;
+    this.partitions.set(context.partitionId, partition);
+
+    if (!force && Date.now() - partition.checkpointedAt < this.checkpointIntervalMs) {
+      return;
+    }
+    partition.checkpointedAt = Date.now();
+    partition.event = undefined;
+    try {
+      await context.updateCheckpoint(event);
+    } catch (err) {
+      console.error('Failed to checkpoint partition %s: %s', context.partitionId, err.message || err);
+    }
+  }
+
+  // Close connection to Event Hub, checkpointing what was processed since the last write
   async stopReadMessage() {
-    const disposeHandlers = [];
-    this.receiveHandlers.forEach((receiveHandler) => {
-      disposeHandlers.push(receiveHandler.stop());
+    const pending = [];
+    this.partitions.forEach((partition) => {
+      if (partition.event) {
+        pending.push(this.checkpoint(partition.context, partition.event, true));
+      }
     });
-    await Promise.all(disposeHandlers);
+    await Promise.all(pending);
 
-    this.consumerClient.close();
+    if (this.subscription) {
+      await this.subscription.close();
+      this.subscription = undefined;
+    }
+    if (this.consumerClient) {
+      await this.consumerClient.close();
+      this.consumerClient = undefined;
+    }
   }
 }
 
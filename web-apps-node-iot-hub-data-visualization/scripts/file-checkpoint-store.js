@@ -0,0 +1,103 @@
+const crypto = require('crypto');
+const fs = require('fs');
+
+// CheckpointStore for EventHubConsumerClient that keeps partition ownership and checkpoints in a
+// local JSON file, so a restarted server resumes each partition where it left off.
+// Meant for a single server instance (or tests); use a blob checkpoint store for several hosts.
+class FileCheckpointStore {
+  constructor(filePath) {
+    this.filePath = filePath;
+    this.state = undefined;
+    this.writing = Promise.resolve();
+  }
+
+  static key(item) {
+    return [item.fullyQualifiedNamespace, item.eventHubName, item.consumerGroup, item.partitionId].join('/').toLowerCase();
+  }
+
+  async load() {
+    if (!this.state) {
+      try {
+        this.state = JSON.parse(await fs.promises.readFile(this.filePath, 'utf8'));
+      } catch (err) {
+        if (err.code !== 'ENOENT') {
+          console.error('Ignoring unreadable checkpoint file [%s]: %s', this.filePath, err.message);
+        }
+        this.state = { ownerships: {}, checkpoints: {} };
+      }
+    }
+    return this.state;
+  }
+
+  // Writes are serialized and atomic (write to a temporary file, then rename)
+  save() {
+    const data = JSON.stringify(this.state);
+    this.writing = this.writing.then(async () => {
+      const tempPath = `${this.filePath}.tmp`;
+      await fs.promises.writeFile(tempPath, data);
+      await fs.promises.rename(tempPath, this.filePath);
+    }).catch((err) => {
+      console.error('Failed to write checkpoint file [%s]: %s', this.filePath, err.message);
+    });
+    return this.writing;
+  }
+
+  static matches(item, fullyQualifiedNamespace, eventHubName, consumerGroup) {
+    return item.fullyQualifiedNamespace.toLowerCase() === fullyQualifiedNamespace.toLowerCase()
+      && item.eventHubName.toLowerCase() === eventHubName.toLowerCase()
+      && item.consumerGroup.toLowerCase() === consumerGroup.toLowerCase();
+  }
+
+  async listOwnership(fullyQualifiedNamespace, eventHubName, consumerGroup) {
+    const state = await this.load();
+    return Object.values(state.ownerships)
+      .filter((ownership) => FileCheckpointStore.matches(ownership, fullyQualifiedNamespace, eventHubName, consumerGroup));
+  }
+
+  async claimOwnership(partitionOwnership) {
+    const state = await this.load();
+    const claimed = [];
+
+    partitionOwnership.forEach((ownership) => {
+      const key = FileCheckpointStore.key(ownership);
+      const existing = state.ownerships[key];
+      // Someone else changed the ownership since it was listed
+      if (existing && existing.etag !== ownership.etag) {
+        return;
+      }
+      const updated = {
+        ...ownership,
+        etag: crypto.randomBytes(8).toString('hex'),
+        lastModifiedTimeInMs: Date.now(),
+      };
+      state.ownerships[key] = updated;
+      claimed.push(updated);
+    });
+
+    if (claimed.length > 0) {
+      await this.save();
+    }
+    return claimed;
+  }
+
+  async listCheckpoints(fullyQualifiedNamespace, eventHubName, consumerGroup) {
+    const state = await this.load();
+    return Object.values(state.checkpoints)
+      .filter((checkpoint) => FileCheckpointStore.matches(checkpoint, fullyQualifiedNamespace, eventHubName, consumerGroup));
+  }
+
+  async updateCheckpoint(checkpoint) {
+    const state = await this.load();
+    state.checkpoints[FileCheckpointStore.key(checkpoint)] = {
+      fullyQualifiedNamespace: checkpoint.fullyQualifiedNamespace,
+      eventHubName: checkpoint.eventHubName,
+      consumerGroup: checkpoint.consumerGroup,
+      partitionId: checkpoint.partitionId,
+      offset: checkpoint.offset,
+      sequenceNumber: checkpoint.sequenceNumber,
+    };
+    await this.save();
+  }
+}
+
+module.exports = FileCheckpointStore;
@@ -0,0 +1,112 @@
+const crypto = require('crypto');
+const fs = require('fs');
+const path = require('path');
+
+// Serves a directory built by build-assets.js from memory (the dashboard is a handful of small files).
+// Hashed assets listed in asset-manifest.json are immutable; everything else (the pages) is
+// revalidated on each load with its ETag. A precompressed .br or .gz sibling is sent when the
+// client accepts it. Paths that are not in the build fall through to the next handler.
+const contentTypes = {
+  '.html': 'text/html; charset=utf-8',
+  '.js': 'application/javascript; charset=utf-8',
+  '.css': 'text/css; charset=utf-8',
+  '.svg': 'image/svg+xml',
+  '.json': 'application/json; charset=utf-8',
+  '.txt': 'text/plain; charset=utf-8',
+  '.png': 'image/png',
+  '.ico': 'image/x-icon',
+};
+
+function listFiles(dir, prefix = '') {
+  return fs.readdirSync(dir, { withFileTypes: true }).reduce((files, entry) => {
+    const relative = path.posix.join(prefix, entry.name);
+    return files.concat(entry.isDirectory() ? listFiles(path.join(dir, entry.name), relative) : [relative]);
+  }, []);
+}
+
+function loadAssets(root) {
+  const manifestFile = path.join(root, 'asset-manifest.json');
+  const hashed = new Set(fs.existsSync(manifestFile) ? Object.values(JSON.parse(fs.readFileSync(manifestFile, 'utf8'))) : []);
+  const files = new Set(listFiles(root));
+  const assets = new Map();
+
+  files.forEach((file) => {
+    if (file.endsWith('.gz') || file.endsWith('.br') || file === 'asset-manifest.json') {
+      return;
+    }
+    const body = fs.readFileSync(path.join(root, file));
+    assets.set(`/${file}`, {
+      body,
+      gzip: files.has(`${file}.gz`) ? fs.readFileSync(path.join(root, `${file}.gz`)) : undefined,
+      brotli: files.has(`${file}.br`) ? fs.readFileSync(path.join(root, `${file}.br`)) : undefined,
+      type: contentTypes[path.extname(file).toLowerCase()] || 'application/octet-stream',
+      etag: `"${crypto.createHash('sha256').update(body).digest('base64').slice(0, 16)}"`,
+      cacheControl: hashed.has(file) ? 'public, max-age=31536000, immutable' : 'no-cache',
+    });
+  });
+  return assets;
+}
+
+function acceptedEncodings(req) {
+  const header = req.headers['accept-encoding'] || '';
+  const accepted = new Set();
+  header.split(',').forEach((part) => {
+    const [name, ...params] = part.trim().toLowerCase().split(';');
+    if (!params.some((param) => /^\s*q=0(\.0*)?\s*$/.test(param))) {
+      accepted.add(name.trim());
+    }
+  });
+  return accepted;
+}
+
+function staticAssets(root) {
+  const assets = loadAssets(root);
+
+  return (req, res, next) => {
+    if (req.method !== 'GET' && req.method !== 'HEAD') {
+      next();
+      return;
+    }
+    let pathname;
+    try {
+      pathname = decodeURIComponent(req.url.split('?')[0]);
+    } catch (err) {
+      next();
+      return;
+    }
+    const asset = assets.get(pathname.endsWith('/') ? `${pathname}index.html` : pathname);
+    if (!asset) {
+      next();
+      return;
+    }
+
+    res.setHeader('Content-Type', asset.type);
+    res.setHeader('Cache-Control', asset.cacheControl);
+    // Weak, since the gzip and brotli encodings share it
+    res.setHeader('ETag', `W/${asset.etag}`);
+    if (asset.gzip || asset.brotli) {
+      res.setHeader('Vary', 'Accept-Encoding');
+    }
+    const ifNoneMatch = req.headers['if-none-match'];
+    if (ifNoneMatch && ifNoneMatch.split(',').some((tag) => tag.trim().replace(/^W\//, '') === asset.etag)) {
+      res.statusCode = 304;
+      res.end();
+      return;
+    }
+
+    const accepted = acceptedEncodings(req);
+    let { body } = asset;
+    if (asset.brotli && accepted.has('br')) {
+      body = asset.brotli;
+      res.setHeader('Content-Encoding', 'br');
+    } else if (asset.gzip && accepted.has('gzip')) {
+      body = asset.gzip;
+      res.setHeader('Content-Encoding', 'gzip');
+    }
+    res.setHeader('Content-Length', body.length);
+    res.statusCode = 200;
+    res.end(req.method === 'HEAD' ? undefined : body);
+  };
+}
+
+module.exports = staticAssets;
@@ -0,0 +1,101 @@
+// Stand-in for EventHubReader that simulates a fleet of Analog Buddy devices, so the server can be
+// run and load tested without an IoT Hub. Messages have the shape the firmware's sendData() posts.
+
+// Slow random walk, kept within [min, max]
+function walk(value, step, min, max) {
+  return Math.min(max, Math.max(min, value + (Math.random() * 2 - 1) * step));
+}
+
+function windowStats(value, spread, n) {
+  return {
+    min: value - spread,
+    max: value + spread,
+    mean: value,
+    var: (spread * spread) / 3,
+    n,
+  };
+}
+
+class SimulatedDevice {
+  constructor(deviceId) {
+    this.deviceId = deviceId;
+    this.temperature = 18 + Math.random() * 8;
+    this.humidity = 35 + Math.random() * 30;
+    this.brightness = Math.random() * 4095;
+  }
+
+  // One telemetry message, as if windowMs had passed since the last one
+  next(windowMs) {
+    this.temperature = walk(this.temperature, 0.1, -10, 50);
+    this.humidity = walk(this.humidity, 0.5, 0, 100);
+    this.brightness = walk(this.brightness, 60, 0, 4095);
+    return {
+      temperature: Math.round(this.temperature * 10) / 10,
+      humidity: Math.round(this.humidity * 10) / 10,
+      brightness: Math.round(this.brightness),
+      window: {
+        ms: Math.round(windowMs),
+        temperature: windowStats(this.temperature, 0.1, Math.round(windowMs / 1000)),
+        humidity: windowStats(this.humidity, 0.5, Math.round(windowMs / 1000)),
+        brightness: windowStats(this.brightness, 30, Math.round(windowMs / 100)),
+      },
+    };
+  }
+}
+
+class SyntheticReader {
+  // options.devices: number of simulated devices
+  // options.ratePerDevice: messages per second from each device (0.2 is the firmware's 5 second interval)
+  // options.tickMs: how often a batch is emitted, like a partition receive
+  constructor(options = {}) {
+    this.ratePerDevice = options.ratePerDevice || 0.2;
+    this.tickMs = options.tickMs || 100;
+    const count = options.devices || 10;
+    const width = String(count).length;
+    this.devices = [];
+    for (let i = 0; i < count; ++i) {
+      this.devices.push(new SimulatedDevice(`buddy-${String(i + 1).padStart(width, '0')}`));
+    }
+    this.next = 0;
+    this.due = 0;
+    this.timer = undefined;
+  }
+
+  // Calls startReadMessageCallback(message, date, deviceId) once per message
+  async startReadMessage(startReadMessageCallback) {
+    await this.startReadMessageBatch((batch) => {
+      batch.forEach(({ message, date, deviceId }) => startReadMessageCallback(message, date, deviceId));
+    });
+  }
+
+  // Calls startReadBatchCallback([{ message, date, deviceId }, ...]) every tick; devices take turns
+  async startReadMessageBatch(startReadBatchCallback) {
+    const windowMs = 1000 / this.ratePerDevice;
+    console.log('Simulating %d devices at %d messages/s each.', this.devices.length, this.ratePerDevice);
+
+    this.timer = setInterval(() => {
+      this.due += (this.devices.length * this.ratePerDevice * this.tickMs) / 1000;
+      const count = Math.floor(this.due);
+      this.due -= count;
+      if (count === 0) {
+        return;
+      }
+
+      const date = new Date().toISOString();
+      const batch = [];
+      for (let i = 0; i < count; ++i) {
+        const device = this.devices[this.next];
+        this.next = (this.next + 1) % this.devices.length;
+        batch.push({ message: device.next(windowMs), date, deviceId: device.deviceId });
+      }
+      startReadBatchCallback(batch);
+    }, this.tickMs);
+  }
+
+  async stopReadMessage() {
+    clearInterval(this.timer);
+    this.timer = undefined;
+  }
+}
+
+module.exports = SyntheticReader;
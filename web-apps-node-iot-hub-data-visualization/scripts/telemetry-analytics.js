@@ -0,0 +1,258 @@
+// Streaming analytics, computed once on the server instead of in every dashboard:
+// per device, rolling statistics over a time window for each reading and for the heat index
+// (the firmware's formula for its default water break timer), plus alert rules evaluated on every
+// sample. Each sample costs O(1) amortized: windows keep running sums and evict expired samples.
+//
+// A rule watches one metric ('temperature', 'humidity', 'brightness' or 'heatIndex') and has one of
+//   above: <value> / below: <value>   the latest value crosses a threshold
+//   rateAbove: <value per minute>     the metric changes faster than this (either way) across the window
+// and an optional hysteresis: an alert is raised when the condition starts to hold and cleared once the
+// value is back past the threshold by the hysteresis, so a noisy reading does not flap.
+
+const DEFAULT_RULES = [
+  { id: 'heat-index-high', metric: 'heatIndex', above: 90, hysteresis: 1 },
+  { id: 'temperature-fast-change', metric: 'temperature', rateAbove: 0.5, hysteresis: 0.1 },
+  { id: 'humidity-low', metric: 'humidity', below: 25, hysteresis: 2 },
+];
+const METRICS = ['temperature', 'humidity', 'brightness', 'heatIndex'];
+
+// Simplified heat index in Fahrenheit, as setDefaultWaterTimer computes it on the device
+function heatIndex(celsius, humidity) {
+  const fahrenheit = (celsius * 9) / 5 + 32;
+  return 0.5 * (fahrenheit + 61 + (fahrenheit - 68) * 1.2 + humidity * 0.094);
+}
+
+function round2(value) {
+  return Math.round(value * 100) / 100;
+}
+
+// Samples of one metric within the last windowMs (at most capacity of them), with running sums
+class RollingWindow {
+  constructor(windowMs, capacity) {
+    this.windowMs = windowMs;
+    this.capacity = capacity;
+    this.time = new Float64Array(capacity);
+    this.value = new Float64Array(capacity);
+    this.start = 0;
+    this.length = 0;
+    this.sum = 0;
+    this.sumSquares = 0;
+  }
+
+  evictOldest() {
+    const value = this.value[this.start];
+    this.sum -= value;
+    this.sumSquares -= value * value;
+    this.start = (this.start + 1) % this.capacity;
+    this.length -= 1;
+  }
+
+  add(time, value) {
+    while (this.length > 0 && (this.length === this.capacity || this.time[this.start] <= time - this.windowMs)) {
+      this.evictOldest();
+    }
+    const index = (this.start + this.length) % this.capacity;
+    this.time[index] = time;
+    this.value[index] = value;
+    this.length += 1;
+    this.sum += value;
+    this.sumSquares += value * value;
+  }
+
+  latest() {
+    return this.value[(this.start + this.length - 1) % this.capacity];
+  }
+
+  mean() {
+    return this.sum / this.length;
+  }
+
+  std() {
+    const mean = this.mean();
+    return Math.sqrt(Math.max(0, this.sumSquares / this.length - mean * mean));
+  }
+
+  // Change per minute from the oldest to the latest sample, undefined until they are minSpanMs apart
+  ratePerMinute(minSpanMs) {
+    const last = (this.start + this.length - 1) % this.capacity;
+    const span = this.time[last] - this.time[this.start];
+    if (this.length < 2 || span < minSpanMs) {
+      return undefined;
+    }
+    return ((this.value[last] - this.value[this.start]) * 60000) / span;
+  }
+
+  summary(minSpanMs) {
+    if (this.length === 0) {
+      return undefined;
+    }
+    const rate = this.ratePerMinute(minSpanMs);
+    return {
+      latest: round2(this.latest()),
+      mean: round2(this.mean()),
+      std: round2(this.std()),
+      ratePerMinute: rate === undefined ? null : round2(rate),
+      samples: this.length,
+    };
+  }
+}
+
+class DeviceAnalytics {
+  constructor(options) {
+    this.lastTime = -Infinity;
+    this.windows = {};
+    METRICS.forEach((metric) => {
+      this.windows[metric] = new RollingWindow(options.windowMs, options.windowCapacity);
+    });
+    // Rule id → alert, for the rules currently raised
+    this.active = new Map();
+  }
+}
+
+class TelemetryAnalytics {
+  constructor(options = {}) {
+    this.options = {
+      windowMs: options.windowMs || 5 * 60 * 1000,
+      windowCapacity: options.windowCapacity || 600,
+      rateMinSpanMs: options.rateMinSpanMs || 60 * 1000,
+      maxDevices: options.maxDevices || 1000,
+    };
+    this.rules = (options.rules || DEFAULT_RULES).filter((rule) => METRICS.includes(rule.metric));
+    // Map order doubles as recency, like the telemetry store
+    this.devices = new Map();
+  }
+
+  // Update the device's windows with one message and evaluate the rules; returns the alerts raised
+  // or cleared by it ({Type: 'alert', ...} messages)
+  add(deviceId, date, message) {
+    const alerts = [];
+    let device = this.devices.get(deviceId);
+    if (device) {
+      this.devices.delete(deviceId);
+    } else {
+      device = new DeviceAnalytics(this.options);
+      if (this.devices.size >= this.options.maxDevices) {
+        // Forget the device that has been quiet the longest, clearing its alerts on the dashboards
+        const [evictedId, evicted] = this.devices.entries().next().value;
+        this.devices.delete(evictedId);
+        evicted.active.forEach((alert) => alerts.push({ ...alert, State: 'cleared', MessageDate: date }));
+      }
+    }
+    this.devices.set(deviceId, device);
+
+    // Windows only move forward; late samples are left out of the analytics
+    const time = new Date(date).getTime();
+    if (!(time > device.lastTime)) {
+      return alerts;
+    }
+    device.lastTime = time;
+
+    const values = {
+      temperature: Number(message.temperature),
+      humidity: Number(message.humidity),
+      brightness: Number(message.brightness),
+    };
+    values.heatIndex = heatIndex(values.temperature, values.humidity);
+    const updated = new Set();
+    METRICS.forEach((metric) => {
+      if (message[metric] !== undefined || metric === 'heatIndex') {
+        if (Number.isFinite(values[metric])) {
+          device.windows[metric].add(time, values[metric]);
+          updated.add(metric);
+        }
+      }
+    });
+
+    this.rules.forEach((rule) => {
+      if (updated.has(rule.metric)) {
+        const alert = this.evaluate(rule, device, deviceId, date);
+        if (alert) {
+          alerts.push(alert);
+        }
+      }
+    });
+    return alerts;
+  }
+
+  // Returns an alert message when the rule's state changed
+  evaluate(rule, device, deviceId, date) {
+    const window = device.windows[rule.metric];
+    const hysteresis = rule.hysteresis || 0;
+    const wasActive = device.active.has(rule.id);
+    let value;
+    let threshold;
+    let active;
+    let condition;
+
+    if (rule.rateAbove !== undefined) {
+      condition = 'rateAbove';
+      value = window.ratePerMinute(this.options.rateMinSpanMs);
+      if (value === undefined) {
+        return undefined;
+      }
+      threshold = rule.rateAbove;
+      active = Math.abs(value) > (wasActive ? threshold - hysteresis : threshold);
+    } else if (rule.above !== undefined) {
+      condition = 'above';
+      value = window.latest();
+      threshold = rule.above;
+      active = value > (wasActive ? threshold - hysteresis : threshold);
+    } else if (rule.below !== undefined) {
+      condition = 'below';
+      value = window.latest();
+      threshold = rule.below;
+      active = value < (wasActive ? threshold + hysteresis : threshold);
+    } else {
+      return undefined;
+    }
+    if (active === wasActive) {
+      return undefined;
+    }
+
+    const alert = {
+      Type: 'alert',
+      DeviceId: deviceId,
+      Rule: rule.id,
+      Metric: rule.metric,
+      Condition: condition,
+      State: active ? 'raised' : 'cleared',
+      Value: round2(value),
+      Threshold: threshold,
+      MessageDate: date,
+    };
+    if (active) {
+      device.active.set(rule.id, alert);
+    } else {
+      device.active.delete(rule.id);
+    }
+    return alert;
+  }
+
+  // Alerts currently raised, on every device
+  activeAlerts() {
+    const alerts = [];
+    this.devices.forEach((device) => device.active.forEach((alert) => alerts.push(alert)));
+    return alerts;
+  }
+
+  // Rolling statistics of one device, undefined for an unknown device
+  summary(deviceId) {
+    const device = this.devices.get(deviceId);
+    if (!device) {
+      return undefined;
+    }
+    const metrics = {};
+    METRICS.forEach((metric) => {
+      metrics[metric] = device.windows[metric].summary(this.options.rateMinSpanMs) || null;
+    });
+    return {
+      Type: 'analytics',
+      DeviceId: deviceId,
+      WindowMs: this.options.windowMs,
+      Metrics: metrics,
+      Alerts: Array.from(device.active.values()),
+    };
+  }
+}
+
+module.exports = TelemetryAnalytics;
@@ -0,0 +1,83 @@
+// Telemetry batches as sent to dashboards, either as JSON ({Type: 'batch', Messages: [...]}) or, for
+// clients that negotiated the BINARY_PROTOCOL subprotocol, as one columnar binary frame:
+//
+//   offset 0            u8  version (1)
+//   offset 1            u8  frame type (1: telemetry batch)
+//   offset 2            u16 reserved
+//   offset 4            u32 count
+//   offset 8            f64 time[count] (ms since epoch)
+//   then                f32 temperature[count], f32 humidity[count], f32 brightness[count] (NaN if missing)
+//   then                u32 device[count] (index announced in 'devices' messages)
+//
+// All little endian; every column is aligned so the client can map it with a typed array view.
+// Only the readings the dashboard charts are packed; JSON clients still get the whole IotData.
+
+const BINARY_PROTOCOL = 'buddy.telemetry.v1';
+const VERSION = 1;
+const FRAME_BATCH = 1;
+const HEADER_BYTES = 8;
+
+// Small integer per DeviceId, so binary frames do not repeat the ids (indexes are never reused)
+class DeviceIndex {
+  constructor() {
+    this.indexes = new Map();
+  }
+
+  indexOf(deviceId) {
+    let index = this.indexes.get(deviceId);
+    if (index === undefined) {
+      index = this.indexes.size;
+      this.indexes.set(deviceId, index);
+    }
+    return index;
+  }
+}
+
+function toFloat(value) {
+  const number = Number(value);
+  return value === undefined || value === null || Number.isNaN(number) ? NaN : number;
+}
+
+// A batch of telemetry payloads ({IotData, MessageDate, DeviceId}); each encoding is built once, when first needed
+class TelemetryBatch {
+  constructor(messages, deviceIndex) {
+    this.messages = messages;
+    this.deviceIndex = deviceIndex;
+    this.binary = undefined;
+  }
+
+  // JSON.stringify(batch) gives the JSON encoding
+  toJSON() {
+    return { Type: 'batch', Messages: this.messages };
+  }
+
+  toBinary() {
+    if (this.binary === undefined) {
+      const count = this.messages.length;
+      const buffer = Buffer.alloc(HEADER_BYTES + count * (8 + 4 * 4));
+      buffer.writeUInt8(VERSION, 0);
+      buffer.writeUInt8(FRAME_BATCH, 1);
+      buffer.writeUInt32LE(count, 4);
+
+      const timeOffset = HEADER_BYTES;
+      const temperatureOffset = timeOffset + count * 8;
+      const humidityOffset = temperatureOffset + count * 4;
+      const brightnessOffset = humidityOffset + count * 4;
+      const deviceOffset = brightnessOffset + count * 4;
+      this.messages.forEach((message, i) => {
+        const data = message.IotData || {};
+        buffer.writeDoubleLE(new Date(message.MessageDate).getTime(), timeOffset + i * 8);
+        buffer.writeFloatLE(toFloat(data.temperature), temperatureOffset + i * 4);
+        buffer.writeFloatLE(toFloat(data.humidity), humidityOffset + i * 4);
+        buffer.writeFloatLE(toFloat(data.brightness), brightnessOffset + i * 4);
+        buffer.writeUInt32LE(this.deviceIndex.indexOf(message.DeviceId), deviceOffset + i * 4);
+      });
+      this.binary = buffer;
+    }
+    return this.binary;
+  }
+}
+
+module.exports = {
+  BINARY_PROTOCOL, DeviceIndex, TelemetryBatch, toFloat,
+};
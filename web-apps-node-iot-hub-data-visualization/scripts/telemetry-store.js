@@ -0,0 +1,196 @@
+// In-memory telemetry history, kept per DeviceId at three resolutions:
+// raw samples, 1 minute and 1 hour rollups (mean of the samples in each bucket).
+// Every series is a preallocated ring buffer, so memory per device is fixed.
+// A missing reading is stored as NaN, left out of the rollup means and sent as null.
+
+const { toFloat } = require('./telemetry-frame.js');
+
+const RESOLUTIONS = {
+  raw: 0,
+  '1m': 60 * 1000,
+  '1h': 60 * 60 * 1000,
+};
+
+// Float32 storage halves memory; trim the float noise when serializing
+function round2(value) {
+  return Number.isNaN(value) ? null : Math.round(value * 100) / 100;
+}
+
+class SeriesRing {
+  constructor(capacity) {
+    this.capacity = capacity;
+    this.time = new Float64Array(capacity);
+    this.temperature = new Float32Array(capacity);
+    this.humidity = new Float32Array(capacity);
+    this.brightness = new Float32Array(capacity);
+    this.start = 0;
+    this.length = 0;
+  }
+
+  push(time, temperature, humidity, brightness) {
+    const index = (this.start + this.length) % this.capacity;
+    this.time[index] = time;
+    this.temperature[index] = temperature;
+    this.humidity[index] = humidity;
+    this.brightness[index] = brightness;
+
+    if (this.length < this.capacity) {
+      this.length += 1;
+    } else {
+      this.start = (this.start + 1) % this.capacity;
+    }
+  }
+
+  // Oldest first, as plain arrays ready for JSON
+  toColumns(since = 0) {
+    const columns = { time: [], temperature: [], humidity: [], brightness: [] };
+    for (let i = 0; i < this.length; ++i) {
+      const index = (this.start + i) % this.capacity;
+      if (this.time[index] >= since) {
+        columns.time.push(this.time[index]);
+        columns.temperature.push(round2(this.temperature[index]));
+        columns.humidity.push(round2(this.humidity[index]));
+        columns.brightness.push(round2(this.brightness[index]));
+      }
+    }
+    return columns;
+  }
+}
+
+// Averages samples into fixed time buckets; a bucket is written to the ring once the next one starts
+class Rollup {
+  constructor(bucketMs, capacity) {
+    this.bucketMs = bucketMs;
+    this.ring = new SeriesRing(capacity);
+    this.bucket = -1;
+    this.count = 0;
+    this.sums = [0, 0, 0];
+    this.counts = [0, 0, 0];
+  }
+
+  add(time, temperature, humidity, brightness) {
+    const bucket = Math.floor(time / this.bucketMs);
+    if (bucket !== this.bucket) {
+      this.flush();
+      this.bucket = bucket;
+    }
+    [temperature, humidity, brightness].forEach((value, i) => {
+      if (!Number.isNaN(value)) {
+        this.sums[i] += value;
+        this.counts[i] += 1;
+      }
+    });
+    this.count += 1;
+  }
+
+  // Mean of reading i in the current bucket, NaN when no sample had it
+  mean(i) {
+    return this.counts[i] > 0 ? this.sums[i] / this.counts[i] : NaN;
+  }
+
+  flush() {
+    if (this.count > 0) {
+      this.ring.push(this.bucket * this.bucketMs, this.mean(0), this.mean(1), this.mean(2));
+    }
+    this.count = 0;
+    this.sums = [0, 0, 0];
+    this.counts = [0, 0, 0];
+  }
+
+  // Closed buckets plus the one still filling
+  toColumns(since = 0) {
+    const columns = this.ring.toColumns(since);
+    if (this.count > 0 && this.bucket * this.bucketMs >= since) {
+      columns.time.push(this.bucket * this.bucketMs);
+      columns.temperature.push(round2(this.mean(0)));
+      columns.humidity.push(round2(this.mean(1)));
+      columns.brightness.push(round2(this.mean(2)));
+    }
+    return columns;
+  }
+}
+
+class DeviceHistory {
+  constructor(options) {
+    this.raw = new SeriesRing(options.rawCapacity);
+    this.minute = new Rollup(RESOLUTIONS['1m'], options.minuteCapacity);
+    this.hour = new Rollup(RESOLUTIONS['1h'], options.hourCapacity);
+  }
+
+  add(time, temperature, humidity, brightness) {
+    this.raw.push(time, temperature, humidity, brightness);
+    this.minute.add(time, temperature, humidity, brightness);
+    this.hour.add(time, temperature, humidity, brightness);
+  }
+
+  series(resolution) {
+    switch (resolution) {
+      case '1m':
+        return this.minute;
+      case '1h':
+        return this.hour;
+      default:
+        return this.raw;
+    }
+  }
+}
+
+class TelemetryStore {
+  constructor(options = {}) {
+    this.options = {
+      rawCapacity: options.rawCapacity || 720, // 1 hour of 5 second samples
+      minuteCapacity: options.minuteCapacity || 24 * 60, // 1 day
+      hourCapacity: options.hourCapacity || 7 * 24, // 1 week
+      maxDevices: options.maxDevices || 1000,
+    };
+    // Map order doubles as recency: a device is re-inserted on every sample
+    this.devices = new Map();
+  }
+
+  add(deviceId, date, message) {
+    let history = this.devices.get(deviceId);
+    if (history) {
+      this.devices.delete(deviceId);
+    } else {
+      history = new DeviceHistory(this.options);
+      if (this.devices.size >= this.options.maxDevices) {
+        // Forget the device that has been quiet the longest
+        this.devices.delete(this.devices.keys().next().value);
+      }
+    }
+    this.devices.set(deviceId, history);
+
+    history.add(new Date(date).getTime(),
+      toFloat(message.temperature),
+      toFloat(message.humidity),
+      toFloat(message.brightness));
+  }
+
+  has(deviceId) {
+    return this.devices.has(deviceId);
+  }
+
+  deviceCount() {
+    return this.devices.size;
+  }
+
+  deviceIds() {
+    return Array.from(this.devices.keys());
+  }
+
+  // History of one device at 'raw', '1m' or '1h' resolution, undefined for an unknown device
+  snapshot(deviceId, resolution = 'raw', since = 0) {
+    const history = this.devices.get(deviceId);
+    if (!history) {
+      return undefined;
+    }
+    return {
+      Type: 'history',
+      DeviceId: deviceId,
+      Resolution: resolution in RESOLUTIONS ? resolution : 'raw',
+      Columns: history.series(resolution).toColumns(since),
+    };
+  }
+}
+
+module.exports = TelemetryStore;
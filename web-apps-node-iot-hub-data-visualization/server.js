@@ -1,65 +1,327 @@
+const cluster = require('cluster');
 const express = require('express');
 const http = require('http');
+const os = require('os');
 const WebSocket = require('ws');
+const fs = require('fs');
 const path = require('path');
 const EventHubReader = require('./scripts/event-hub-reader.js');
+const staticAssets = require('./scripts/static-assets.js');
+const SyntheticReader = require('./scripts/synthetic-reader.js');
+const Broadcaster = require('./scripts/broadcaster.js');
+const TelemetryStore = require('./scripts/telemetry-store.js');
+const TelemetryAnalytics = require('./scripts/telemetry-analytics.js');
+const { BINARY_PROTOCOL, DeviceIndex, TelemetryBatch } = require('./scripts/telemetry-frame.js');
+const { ClusterPublisher, ClusterSubscriber } = require('./scripts/cluster-bus.js');
 
-const iotHubConnectionString = process.env.IotHubConnectionString;
-if (!iotHubConnectionString) {
-  console.error(`Environment variable IotHubConnectionString must be specified.`);
+const metricsLogInterval = Number(process.env.MetricsLogIntervalSeconds || 60) * 1000;
+
+// Where telemetry comes from: 'iothub' (default) or 'synthetic' (a simulated fleet, for load tests)
+const messageSource = process.env.MessageSource || 'iothub';
+if (messageSource !== 'iothub' && messageSource !== 'synthetic') {
+  console.error(`Environment variable MessageSource must be 'iothub' or 'synthetic'.`);
   return;
 }
-console.log(`Using IoT Hub connection string [${iotHubConnectionString}]`);
 
+const iotHubConnectionString = process.env.IotHubConnectionString;
 const eventHubConsumerGroup = process.env.EventHubConsumerGroup;
-console.log(eventHubConsumerGroup);
-if (!eventHubConsumerGroup) {
-  console.error(`Environment variable EventHubConsumerGroup must be specified.`);
+if (messageSource === 'iothub') {
+  if (!iotHubConnectionString) {
+    console.error(`Environment variable IotHubConnectionString must be specified.`);
+    return;
+  }
+  console.log(`Using IoT Hub connection string [${iotHubConnectionString}]`);
+
+  if (!eventHubConsumerGroup) {
+    console.error(`Environment variable EventHubConsumerGroup must be specified.`);
+    return;
+  }
+  console.log(`Using event hub consumer group [${eventHubConsumerGroup}]`);
+}
+
+// Alert rules evaluated on every sample (see scripts/telemetry-analytics.js), as a JSON array
+let alertRules;
+if (process.env.AlertRules) {
+  try {
+    alertRules = JSON.parse(process.env.AlertRules);
+  } catch (err) {
+    console.error(`Environment variable AlertRules must be a JSON array of rules: [${err.message}].`);
+    return;
+  }
+}
+
+// Cluster mode: the primary runs the only reader and publishes its batches to the workers,
+// each of which serves HTTP and WebSockets on the shared port with its own store and broadcaster
+const clusterWorkers = process.env.ClusterWorkers === 'auto' ? os.cpus().length : Number(process.env.ClusterWorkers) || 1;
+const isPrimary = cluster.isPrimary === undefined ? cluster.isMaster : cluster.isPrimary;
+if (clusterWorkers > 1 && isPrimary) {
+  console.log('Starting %d workers.', clusterWorkers);
+  const publisher = new ClusterPublisher(clusterWorkers);
+  const primaryReader = createReader();
+  primaryReader.startReadMessageBatch((batch) => publisher.publish(batch)).catch((err) => console.error(err.message || err));
+
+  let stopping = false;
+  const stopPrimary = async (signal) => {
+    if (stopping) {
+      return;
+    }
+    stopping = true;
+    console.log('Received %s, shutting down.', signal);
+    try {
+      await primaryReader.stopReadMessage();
+    } catch (err) {
+      console.error('Error closing message reader: [%s].', err);
+    }
+    await publisher.stop();
+    process.exit(0);
+  };
+  process.on('SIGINT', () => stopPrimary('SIGINT'));
+  process.on('SIGTERM', () => stopPrimary('SIGTERM'));
   return;
 }
-console.log(`Using event hub consumer group [${eventHubConsumerGroup}]`);
 
-// Redirect requests to the public subdirectory to the root
+// Serve the hashed, precompressed build of public/ (npm run build) when there is one
 const app = express();
-app.use(express.static(path.join(__dirname, 'public')));
+const distDir = path.join(__dirname, 'dist');
+const publicDir = path.join(__dirname, 'public');
+const manifestFile = path.join(distDir, 'asset-manifest.json');
+const useDist = fs.existsSync(manifestFile);
+app.use(useDist ? staticAssets(distDir) : express.static(publicDir));
+if (!cluster.worker || cluster.worker.id === 1) {
+  console.log('Serving the dashboard from %s.', useDist ? distDir : publicDir);
+  // node server.js does not rebuild (npm start does)
+  const newestSource = (dir) => fs.readdirSync(dir, { withFileTypes: true }).reduce((newest, entry) => {
+    const target = path.join(dir, entry.name);
+    return Math.max(newest, entry.isDirectory() ? newestSource(target) : fs.statSync(target).mtimeMs);
+  }, 0);
+  if (useDist && newestSource(publicDir) > fs.statSync(manifestFile).mtimeMs) {
+    console.warn('public/ changed since the last build, run npm run build to serve the changes.');
+  }
+}
+// History of one device: /api/history/<DeviceId>?resolution=raw|1m|1h&since=<ms since epoch>
+app.get('/api/history/:deviceId', (req, res) => {
+  const snapshot = store.snapshot(req.params.deviceId, req.query.resolution, Number(req.query.since) || 0);
+  if (!snapshot) {
+    res.status(404).json({ error: `Unknown device ${req.params.deviceId}` });
+    return;
+  }
+  res.json(snapshot);
+});
+// Rolling statistics, heat index and raised alerts of one device
+app.get('/api/analytics/:deviceId', (req, res) => {
+  const summary = analytics.summary(req.params.deviceId);
+  if (!summary) {
+    res.status(404).json({ error: `Unknown device ${req.params.deviceId}` });
+    return;
+  }
+  res.json(summary);
+});
+app.get('/metrics', (req, res) => {
+  res.json({
+    broadcast: broadcaster.getMetrics(),
+    worker: cluster.worker ? cluster.worker.id : 0,
+    devices: store.deviceCount(),
+    memory: process.memoryUsage(),
+  });
+});
+// Missing assets (anything with a file extension) and API paths are 404s; other paths redirect to the dashboard
 app.use((req, res /* , next */) => {
+  const pathname = req.path || req.url.split('?')[0];
+  if (pathname.startsWith('/api/') || path.posix.extname(pathname) !== '') {
+    res.status(404).end();
+    return;
+  }
   res.redirect('/');
 });
 
 const server = http.createServer(app);
-const wss = new WebSocket.Server({ server });
+// Clients offering BINARY_PROTOCOL get telemetry as columnar binary frames, others get JSON;
+// permessage-deflate (WebSocketCompression=off to disable) compresses both
+const wss = new WebSocket.Server({
+  server,
+  perMessageDeflate: process.env.WebSocketCompression === 'off' ? false : {
+    threshold: 256,
+    zlibDeflateOptions: { level: 3, memLevel: 8 },
+    serverMaxWindowBits: 13,
+    concurrencyLimit: 8,
+  },
+  handleProtocols: (protocols) => (Array.from(protocols).includes(BINARY_PROTOCOL) ? BINARY_PROTOCOL : false),
+});
 
-wss.broadcast = (data) => {
-  wss.clients.forEach((client) => {
-    if (client.readyState === WebSocket.OPEN) {
-      try {
-        console.log(`Broadcasting data ${data}`);
-        client.send(data);
-      } catch (e) {
-        console.error(e);
+const broadcaster = new Broadcaster(wss, { binaryProtocol: BINARY_PROTOCOL });
+const deviceIndex = new DeviceIndex();
+const store = new TelemetryStore({
+  rawCapacity: Number(process.env.HistoryRawPoints) || undefined,
+  maxDevices: Number(process.env.HistoryMaxDevices) || undefined,
+});
+const analytics = new TelemetryAnalytics({
+  windowMs: Number(process.env.AnalyticsWindowSeconds) * 1000 || undefined,
+  rules: alertRules,
+  maxDevices: Number(process.env.HistoryMaxDevices) || undefined,
+});
+
+const maxSubscriptionsPerMessage = 100;
+
+// Subscription protocol:
+// - the server sends {Type: 'devices', DeviceIds: [...], Indexes: [...]} on connect and whenever a new
+//   device appears (binary frames refer to devices by these indexes)
+// - a client sends {Type: 'subscribe' | 'unsubscribe', DeviceIds: [...]} ('*' for every device)
+// - each newly subscribed device is backfilled with a {Type: 'history'} snapshot of its raw history
+// - every client gets {Type: 'alert', State: 'raised' | 'cleared', ...} when an alert rule changes state
+//   on any device, and {Type: 'alerts', Alerts: [...]} with the raised ones on connect
+// - a client that fell so far behind that telemetry was dropped gets {Type: 'resync'}; it should
+//   unsubscribe and subscribe again to get fresh history snapshots
+function onClientMessage(ws, data) {
+  let request;
+  try {
+    request = JSON.parse(data);
+  } catch (err) {
+    return;
+  }
+  if (!request || !Array.isArray(request.DeviceIds)) {
+    return;
+  }
+
+  const deviceIds = request.DeviceIds.filter((deviceId) => typeof deviceId === 'string').slice(0, maxSubscriptionsPerMessage);
+  if (request.Type === 'subscribe') {
+    broadcaster.subscribe(ws, deviceIds).forEach((deviceId) => {
+      // Skipped when the client is behind; it gets a resync marker and resubscribes instead
+      const snapshot = store.snapshot(deviceId, 'raw');
+      if (snapshot) {
+        broadcaster.send(ws, snapshot, { coalesce: false, optional: true });
       }
-    }
-  });
-};
+    });
+  } else if (request.Type === 'unsubscribe') {
+    broadcaster.unsubscribe(ws, deviceIds);
+  }
+}
+
+function devicesMessage(deviceIds) {
+  return { Type: 'devices', DeviceIds: deviceIds, Indexes: deviceIds.map((deviceId) => deviceIndex.indexOf(deviceId)) };
+}
+
+wss.on('connection', (ws) => {
+  broadcaster.send(ws, devicesMessage(store.deviceIds()), { coalesce: false });
+  broadcaster.send(ws, { Type: 'alerts', Alerts: analytics.activeAlerts() }, { coalesce: false });
+  ws.on('message', (data) => onClientMessage(ws, data));
+});
+
+// Summarize fan-out instead of logging every send
+setInterval(() => {
+  const metrics = broadcaster.getMetrics();
+  if (metrics.messages > 0) {
+    console.log('Broadcast %d messages to %d clients (%d sends, %d KB, %d coalesced, %d dropped, %d evicted), fan-out avg %dus max %dus.',
+      metrics.messages, metrics.clients, metrics.sends, Math.round(metrics.bytes / 1024), metrics.coalesced, metrics.dropped,
+      metrics.evicted, Math.round(metrics.fanoutUsAvg), Math.round(metrics.fanoutUsMax));
+  }
+  broadcaster.resetMetrics();
+}, metricsLogInterval).unref();
 
 server.listen(process.env.PORT || '3000', () => {
   console.log('Listening on %d.', server.address().port);
 });
 
-const eventHubReader = new EventHubReader(iotHubConnectionString, eventHubConsumerGroup);
+// Every reader has the same interface: startReadMessageBatch(callback) and stopReadMessage()
+// (in cluster mode, workers read the primary's batches through a ClusterSubscriber)
+function createReader() {
+  if (messageSource === 'synthetic') {
+    return new SyntheticReader({
+      devices: Number(process.env.SyntheticDevices) || undefined,
+      ratePerDevice: Number(process.env.SyntheticRatePerDevice) || undefined,
+    });
+  }
+  // Checkpoints let a restarted server resume each partition where it stopped
+  return new EventHubReader(iotHubConnectionString, eventHubConsumerGroup, {
+    checkpointFile: process.env.CheckpointFile === 'none' ? undefined : (process.env.CheckpointFile || path.join(__dirname, '.checkpoints.json')),
+    startPosition: process.env.EventHubStartPosition,
+    checkpointIntervalMs: Number(process.env.CheckpointIntervalSeconds || 5) * 1000,
+  });
+}
+const reader = cluster.worker ? new ClusterSubscriber() : createReader();
+
+// Batches from every partition received in the same tick go out as one WebSocket frame per device
+// (and one frame with everything for clients subscribed to every device)
+// Devices seen for the first time are announced once per tick too, so a fleet coming online
+// does not flood slow clients; announcements and alerts are never coalesced away
+let pending = [];
+let newDevices = [];
+let alerts = [];
+let flushScheduled = false;
+
+function flushPending() {
+  const messages = pending;
+  pending = [];
+  flushScheduled = false;
+  try {
+    if (newDevices.length > 0) {
+      broadcaster.broadcast(devicesMessage(newDevices), { coalesce: false });
+      newDevices = [];
+    }
+    alerts.forEach((alert) => broadcaster.broadcast(alert, { coalesce: false }));
+    alerts = [];
+    const byDevice = new Map();
+    messages.forEach((payload) => {
+      if (!byDevice.has(payload.DeviceId)) {
+        byDevice.set(payload.DeviceId, []);
+      }
+      byDevice.get(payload.DeviceId).push(payload);
+    });
+    byDevice.forEach((deviceMessages, deviceId) => {
+      broadcaster.publish(deviceId, new TelemetryBatch(deviceMessages, deviceIndex));
+    });
+    if (broadcaster.hasWildcardSubscribers()) {
+      broadcaster.publishAll(new TelemetryBatch(messages, deviceIndex));
+    }
+  } catch (err) {
+    console.error('Error broadcasting batch of %d messages: [%s].', messages.length, err);
+  }
+}
 
 (async () => {
-  await eventHubReader.startReadMessage((message, date, deviceId) => {
-    try {
-      const payload = {
-        IotData: message,
-        MessageDate: date || Date.now().toISOString(),
-        DeviceId: deviceId,
-      };
+  await reader.startReadMessageBatch((batch) => {
+    batch.forEach(({ message, date, deviceId }) => {
+      try {
+        const payload = {
+          IotData: message,
+          MessageDate: date || new Date().toISOString(),
+          DeviceId: deviceId,
+        };
 
-      wss.broadcast(JSON.stringify(payload));
-    } catch (err) {
-      console.error('Error broadcasting: [%s] from [%s].', err, message);
+        const isNewDevice = !store.has(deviceId);
+        store.add(deviceId, payload.MessageDate, message);
+        alerts.push(...analytics.add(deviceId, payload.MessageDate, message));
+        if (isNewDevice) {
+          newDevices.push(deviceId);
+        }
+        pending.push(payload);
+      } catch (err) {
+        console.error('Error storing: [%s] from [%s].', err, message);
+      }
+    });
+
+    if (pending.length > 0 && !flushScheduled) {
+      flushScheduled = true;
+      setImmediate(flushPending);
     }
   });
-})().catch();
\ No newline at end of file
+})().catch();
+
+// Stop reading (writing final checkpoints) before exiting
+let shuttingDown = false;
+async function shutdown(signal) {
+  if (shuttingDown) {
+    return;
+  }
+  shuttingDown = true;
+  console.log('Received %s, shutting down.', signal);
+  try {
+    await reader.stopReadMessage();
+  } catch (err) {
+    console.error('Error closing message reader: [%s].', err);
+  }
+  wss.clients.forEach((client) => client.close(1001, 'Server shutting down'));
+  server.close(() => process.exit(0));
+  setTimeout(() => process.exit(0), 5000).unref();
+}
+process.on('SIGINT', () => shutdown('SIGINT'));
+process.on('SIGTERM', () => shutdown('SIGTERM'));
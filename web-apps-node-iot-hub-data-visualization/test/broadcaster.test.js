@@ -0,0 +1,109 @@
+// Broadcaster backpressure with fake sockets (npm test)
+const assert = require('assert');
+const EventEmitter = require('events');
+const WebSocket = require('ws');
+const Broadcaster = require('../scripts/broadcaster.js');
+
+// A socket whose sends complete only when the test says so
+class FakeClient extends EventEmitter {
+  constructor() {
+    super();
+    this.readyState = WebSocket.OPEN;
+    this.bufferedAmount = 0;
+    this.sent = [];
+    this.callbacks = [];
+  }
+
+  send(payload, callback) {
+    this.sent.push(payload);
+    this.callbacks.push(callback);
+  }
+
+  // Complete the oldest send
+  drain() {
+    this.callbacks.shift()();
+  }
+
+  terminate() {
+    this.readyState = WebSocket.CLOSED;
+    this.emit('close');
+  }
+}
+
+function setup(options) {
+  const wss = new EventEmitter();
+  const broadcaster = new Broadcaster(wss, options);
+  const client = new FakeClient();
+  wss.emit('connection', client);
+  return { broadcaster, client };
+}
+
+const tests = {
+  'a slow client still gets messages that must not be coalesced': () => {
+    const { broadcaster, client } = setup({ maxInFlight: 1, maxBufferedBytes: 100 });
+    broadcaster.broadcast('telemetry 1');
+    // Over the byte cap with nothing in flight: everything has to wait
+    client.bufferedAmount = 1000;
+    broadcaster.broadcast('alert', { coalesce: false });
+    broadcaster.broadcast('telemetry 2');
+    broadcaster.broadcast('devices', { coalesce: false });
+    broadcaster.broadcast('telemetry 3');
+    assert.deepStrictEqual(client.sent, ['telemetry 1']);
+
+    client.bufferedAmount = 0;
+    while (client.callbacks.length > 0) {
+      client.drain();
+    }
+    assert.deepStrictEqual(client.sent, ['telemetry 1', 'alert', 'devices', '{"Type":"resync"}', 'telemetry 3']);
+    assert.strictEqual(broadcaster.getMetrics().dropped, 1);
+  },
+
+  'a client that only fell behind gets no resync marker': () => {
+    const { broadcaster, client } = setup({ maxInFlight: 1 });
+    broadcaster.broadcast('telemetry 1');
+    broadcaster.broadcast('telemetry 2');
+    client.drain();
+    client.drain();
+    assert.deepStrictEqual(client.sent, ['telemetry 1', 'telemetry 2']);
+    assert.strictEqual(broadcaster.getMetrics().coalesced, 1);
+    assert.strictEqual(broadcaster.getMetrics().resyncs, 0);
+  },
+
+  'history snapshots over the byte cap are skipped for a resync': () => {
+    const { broadcaster, client } = setup({ maxInFlight: 1, maxBufferedBytes: 25 });
+    broadcaster.send(client, 'history 1.....', { coalesce: false, optional: true });
+    broadcaster.send(client, 'history 2.....', { coalesce: false, optional: true });
+    broadcaster.send(client, 'history 3.....', { coalesce: false, optional: true });
+    broadcaster.send(client, 'history 4.....', { coalesce: false, optional: true });
+    broadcaster.broadcast('alert', { coalesce: false });
+    while (client.callbacks.length > 0) {
+      client.drain();
+    }
+    assert.deepStrictEqual(client.sent, ['history 1.....', 'history 2.....', 'alert', '{"Type":"resync"}']);
+    assert.strictEqual(broadcaster.getMetrics().skipped, 2);
+  },
+
+  'a client that lets the queue fill up is disconnected': () => {
+    const { broadcaster, client } = setup({ maxInFlight: 1, maxQueued: 2 });
+    broadcaster.broadcast('alert 1', { coalesce: false });
+    broadcaster.broadcast('alert 2', { coalesce: false });
+    broadcaster.broadcast('alert 3', { coalesce: false });
+    assert.strictEqual(client.readyState, WebSocket.OPEN);
+    broadcaster.broadcast('alert 4', { coalesce: false });
+    assert.strictEqual(client.readyState, WebSocket.CLOSED);
+    assert.strictEqual(broadcaster.getMetrics().evicted, 1);
+    assert.strictEqual(broadcaster.getMetrics().clients, 0);
+  },
+};
+
+let failed = 0;
+Object.keys(tests).forEach((name) => {
+  try {
+    tests[name]();
+    console.log('ok - %s', name);
+  } catch (err) {
+    failed += 1;
+    console.log('not ok - %s\n%s', name, err.stack);
+  }
+});
+process.exitCode = failed > 0 ? 1 : 0;
@@ -0,0 +1,32 @@
+// TelemetryAnalytics alert rules (npm test)
+const assert = require('assert');
+const TelemetryAnalytics = require('../scripts/telemetry-analytics.js');
+
+const rules = [{ id: 'humidity-low', metric: 'humidity', below: 25 }];
+
+const tests = {
+  'a device evicted with a raised alert has it cleared': () => {
+    const analytics = new TelemetryAnalytics({ rules, maxDevices: 1 });
+    const raised = analytics.add('dry', '2026-01-01T00:00:00Z', { humidity: 20 });
+    assert.deepStrictEqual(raised.map((alert) => alert.State), ['raised']);
+
+    const alerts = analytics.add('other', '2026-01-01T00:00:05Z', { humidity: 50 });
+    assert.strictEqual(alerts.length, 1);
+    assert.strictEqual(alerts[0].DeviceId, 'dry');
+    assert.strictEqual(alerts[0].Rule, 'humidity-low');
+    assert.strictEqual(alerts[0].State, 'cleared');
+    assert.deepStrictEqual(analytics.activeAlerts(), []);
+  },
+};
+
+let failed = 0;
+Object.keys(tests).forEach((name) => {
+  try {
+    tests[name]();
+    console.log('ok - %s', name);
+  } catch (err) {
+    failed += 1;
+    console.log('not ok - %s\n%s', name, err.stack);
+  }
+});
+process.exitCode = failed > 0 ? 1 : 0;
@@ -0,0 +1,36 @@
+// TelemetryStore history and rollups (npm test)
+const assert = require('assert');
+const TelemetryStore = require('../scripts/telemetry-store.js');
+
+const tests = {
+  'a missing reading is stored as null, not 0': () => {
+    const store = new TelemetryStore();
+    store.add('device', '2026-01-01T00:00:00Z', { temperature: 20, humidity: 50, brightness: 0 });
+    store.add('device', '2026-01-01T00:00:05Z', { temperature: 22 });
+    const columns = store.snapshot('device', 'raw').Columns;
+    assert.deepStrictEqual(columns.humidity, [50, null]);
+    assert.deepStrictEqual(columns.brightness, [0, null]);
+  },
+
+  'rollups average only the samples that have the reading': () => {
+    const store = new TelemetryStore();
+    store.add('device', '2026-01-01T00:00:00Z', { temperature: 20, humidity: 50 });
+    store.add('device', '2026-01-01T00:00:05Z', { temperature: 22 });
+    store.add('device', '2026-01-01T00:01:00Z', { temperature: 24 });
+    const columns = store.snapshot('device', '1m').Columns;
+    assert.deepStrictEqual(columns.temperature, [21, 24]);
+    assert.deepStrictEqual(columns.humidity, [50, null]);
+  },
+};
+
+let failed = 0;
+Object.keys(tests).forEach((name) => {
+  try {
+    tests[name]();
+    console.log('ok - %s', name);
+  } catch (err) {
+    failed += 1;
+    console.log('not ok - %s\n%s', name, err.stack);
+  }
+});
+process.exitCode = failed > 0 ? 1 : 0;